@@ -0,0 +1,169 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "audio_gain.h"
+
+
+// --- AudioGain -----------------------------------------------------------------
+const int32_t AudioGain::gain_unity = 1 << 14;
+const size_t AudioGain::ramp_ms = 20;
+
+AudioGain::AudioGain() {
+	channels = 1;
+	ramp_frames = 1;
+
+	gain_target = gain_unity;
+	gain_ramp_target = gain_unity;
+	gain = gain_unity << 16;
+	gain_step = 0;
+}
+
+void AudioGain::SetFormat(int samplerate, int channels) {
+	this->channels = channels;
+	ramp_frames = std::max((size_t) samplerate * ramp_ms / 1000, (size_t) 1);
+}
+
+void AudioGain::SetGain(double value) {
+	value = std::min(std::max(value, 0.0), 1.0);
+	gain_target = (int32_t) (value * gain_unity + 0.5);
+}
+
+bool AudioGain::IsUnity() {
+	return gain_target == gain_unity && gain == gain_unity << 16;
+}
+
+void AudioGain::Process(int16_t *dst, const int16_t *src, size_t samples) {
+	// (re)start ramp on new target
+	int32_t target = gain_target;
+	if(target != gain_ramp_target) {
+		gain_ramp_target = target;
+		gain_step = ((target << 16) - gain) / (int32_t) ramp_frames;
+		if(gain_step == 0)
+			gain_step = (target << 16) > gain ? 1 : -1;
+	}
+
+	size_t frames = samples / channels;
+	while(frames) {
+		// constant gain
+		if(gain == target << 16) {
+			size_t len = frames * channels * sizeof(int16_t);
+			if(target == gain_unity) {
+				if(dst != src)
+					memcpy(dst, src, len);
+			} else if(target == 0) {
+				memset(dst, 0x00, len);
+			} else {
+				ApplyGainRamp(dst, src, frames, channels, gain, 0);
+			}
+			return;
+		}
+
+		// ramp (until target reached)
+		int32_t distance = (target << 16) - gain;
+		size_t ramp_frames_left = (distance + gain_step - (gain_step > 0 ? 1 : -1)) / gain_step;	// rounded up
+		size_t ramp_len = std::min(frames, ramp_frames_left);
+		ApplyGainRamp(dst, src, ramp_len, channels, gain, gain_step);
+
+		if(ramp_len == ramp_frames_left)
+			gain = target << 16;
+		else
+			gain += gain_step * (int32_t) ramp_len;
+
+		dst += ramp_len * channels;
+		src += ramp_len * channels;
+		frames -= ramp_len;
+	}
+}
+
+void AudioGain::ApplyGainRamp(int16_t *dst, const int16_t *src, size_t frames, int channels, int32_t gain, int32_t gain_step) {
+	size_t samples = frames * channels;
+	size_t i = 0;
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(__ARM_NEON) || defined(__ARM_NEON__)
+	// vectorized, for mono/stereo
+	if(channels == 1 || channels == 2) {
+		int shift = channels - 1;	// sample index -> frame index
+#if defined(__AVX2__)
+		// in-lane unpack/pack order: samples 0-3 + 8-11 and 4-7 + 12-15
+		__m256i offsets_a = _mm256_mullo_epi32(_mm256_srli_epi32(_mm256_setr_epi32(0, 1, 2, 3, 8, 9, 10, 11), shift), _mm256_set1_epi32(gain_step));
+		__m256i offsets_b = _mm256_mullo_epi32(_mm256_srli_epi32(_mm256_setr_epi32(4, 5, 6, 7, 12, 13, 14, 15), shift), _mm256_set1_epi32(gain_step));
+		__m256i rounding = _mm256_set1_epi32(1 << 13);
+		for(; i + 16 <= samples; i += 16) {
+			__m256i gains_base = _mm256_set1_epi32(gain);
+			__m256i gains = _mm256_packs_epi32(
+					_mm256_srai_epi32(_mm256_add_epi32(gains_base, offsets_a), 16),
+					_mm256_srai_epi32(_mm256_add_epi32(gains_base, offsets_b), 16));
+
+			__m256i s = _mm256_loadu_si256((const __m256i*) (src + i));
+			__m256i lo = _mm256_mullo_epi16(s, gains);
+			__m256i hi = _mm256_mulhi_epi16(s, gains);
+			__m256i p0 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_unpacklo_epi16(lo, hi), rounding), 14);
+			__m256i p1 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_unpackhi_epi16(lo, hi), rounding), 14);
+			_mm256_storeu_si256((__m256i*) (dst + i), _mm256_packs_epi32(p0, p1));
+
+			gain += gain_step * (16 >> shift);
+		}
+#elif defined(__SSE2__)
+		// (no 32 bit multiplication in SSE2, so the offsets are calculated by hand)
+		__m128i offsets_a = _mm_setr_epi32(0, gain_step * (1 >> shift), gain_step * (2 >> shift), gain_step * (3 >> shift));
+		__m128i offsets_b = _mm_setr_epi32(gain_step * (4 >> shift), gain_step * (5 >> shift), gain_step * (6 >> shift), gain_step * (7 >> shift));
+		__m128i rounding = _mm_set1_epi32(1 << 13);
+		for(; i + 8 <= samples; i += 8) {
+			__m128i gains_base = _mm_set1_epi32(gain);
+			__m128i gains = _mm_packs_epi32(
+					_mm_srai_epi32(_mm_add_epi32(gains_base, offsets_a), 16),
+					_mm_srai_epi32(_mm_add_epi32(gains_base, offsets_b), 16));
+
+			__m128i s = _mm_loadu_si128((const __m128i*) (src + i));
+			__m128i lo = _mm_mullo_epi16(s, gains);
+			__m128i hi = _mm_mulhi_epi16(s, gains);
+			__m128i p0 = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(lo, hi), rounding), 14);
+			__m128i p1 = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(lo, hi), rounding), 14);
+			_mm_storeu_si128((__m128i*) (dst + i), _mm_packs_epi32(p0, p1));
+
+			gain += gain_step * (8 >> shift);
+		}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+		const int32_t offsets_a_raw[] = {0, gain_step * (1 >> shift), gain_step * (2 >> shift), gain_step * (3 >> shift)};
+		const int32_t offsets_b_raw[] = {gain_step * (4 >> shift), gain_step * (5 >> shift), gain_step * (6 >> shift), gain_step * (7 >> shift)};
+		int32x4_t offsets_a = vld1q_s32(offsets_a_raw);
+		int32x4_t offsets_b = vld1q_s32(offsets_b_raw);
+		for(; i + 8 <= samples; i += 8) {
+			int32x4_t gains_base = vdupq_n_s32(gain);
+			int16x4_t gains_a = vmovn_s32(vshrq_n_s32(vaddq_s32(gains_base, offsets_a), 16));
+			int16x4_t gains_b = vmovn_s32(vshrq_n_s32(vaddq_s32(gains_base, offsets_b), 16));
+
+			int16x8_t s = vld1q_s16(src + i);
+			int16x4_t r_a = vqrshrn_n_s32(vmull_s16(vget_low_s16(s), gains_a), 14);
+			int16x4_t r_b = vqrshrn_n_s32(vmull_s16(vget_high_s16(s), gains_b), 14);
+			vst1q_s16(dst + i, vcombine_s16(r_a, r_b));
+
+			gain += gain_step * (8 >> shift);
+		}
+#endif
+	}
+#endif
+
+	// remaining samples
+	for(; i < samples; i += channels) {
+		int32_t g = gain >> 16;
+		for(int c = 0; c < channels; c++)
+			dst[i + c] = (src[i + c] * g + (1 << 13)) >> 14;
+		gain += gain_step;
+	}
+}
@@ -0,0 +1,62 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUDIO_GAIN_H_
+#define AUDIO_GAIN_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+
+// --- AudioGain -----------------------------------------------------------------
+// applies a volume to S16 samples, with short linear ramps between volume changes
+class AudioGain {
+private:
+	int channels;
+	size_t ramp_frames;
+
+	std::atomic<int32_t> gain_target;	// Q14 (set by any thread)
+	int32_t gain_ramp_target;			// Q14
+	int32_t gain;						// Q14.16
+	int32_t gain_step;					// Q14.16 (per frame)
+
+	static const int32_t gain_unity;
+	static const size_t ramp_ms;
+
+	static void ApplyGainRamp(int16_t *dst, const int16_t *src, size_t frames, int channels, int32_t gain, int32_t gain_step);
+public:
+	AudioGain();
+
+	void SetFormat(int samplerate, int channels);
+	void SetGain(double value);
+	bool IsUnity();
+
+	void Process(int16_t *dst, const int16_t *src, size_t samples);	// dst may equal src
+};
+
+#endif /* AUDIO_GAIN_H_ */
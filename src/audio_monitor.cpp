@@ -0,0 +1,392 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "audio_monitor.h"
+
+
+// --- AUDIO_MONITOR_EVENT -----------------------------------------------------------------
+const char* AUDIO_MONITOR_EVENT::GetTypeName() const {
+	switch(type) {
+	case Type::SilenceStart:
+		return "silence_start";
+	case Type::SilenceEnd:
+		return "silence_end";
+	case Type::ClippingStart:
+		return "clipping_start";
+	case Type::ClippingEnd:
+		return "clipping_end";
+	}
+	return "unknown";
+}
+
+
+// --- AudioMonitor -----------------------------------------------------------------
+const size_t AudioMonitor::block_ms = 100;
+const double AudioMonitor::silence_threshold_dbfs = -60.0;
+const size_t AudioMonitor::silence_alarm_ms = 5000;
+const size_t AudioMonitor::clipping_hold_ms = 1000;
+const double AudioMonitor::gating_min_lufs = -70.0;	// absolute gate
+const double AudioMonitor::gating_max_lufs = 5.0;
+const double AudioMonitor::gating_resolution_lu = 0.1;
+
+AudioMonitor::AudioMonitor(AudioMonitorObserver *observer) {
+	this->observer = observer;
+
+	samplerate = 0;
+	channels = 0;
+
+	block_frames = 0;
+	block_pos = 0;
+	block_kw_sum = 0.0;
+	block_sq_sum = 0;
+	block_max = INT16_MIN;
+	block_min = INT16_MAX;
+	block_clipped = 0;
+
+	block_powers_count = 0;
+	block_powers_index = 0;
+
+	size_t gating_bins = (gating_max_lufs - gating_min_lufs) / gating_resolution_lu;
+	gating_counts.resize(gating_bins);
+	gating_powers.resize(gating_bins);
+
+	blocks_total = 0;
+	silent_blocks = 0;
+	silence_alarm = false;
+	clipping_start_block = 0;
+	clipping_last_block = 0;
+	clipping_samples = 0;
+	clipping_alarm = false;
+}
+
+void AudioMonitor::SetFormat(int samplerate, int channels) {
+	if(this->samplerate == samplerate && this->channels == channels)
+		return;
+	this->samplerate = samplerate;
+	this->channels = channels;
+
+	// K-weighting filter coefficients for the actual samplerate (see ITU-R BS.1770)
+	double k = tan(M_PI * 1681.974450955533 / samplerate);
+	double q = 0.7071752369554196;
+	double vh = pow(10.0, 3.999843853973347 / 20.0);
+	double vb = pow(vh, 0.4996667741545416);
+	double a0 = 1.0 + k / q + k * k;
+	pre_b[0] = (vh + vb * k / q + k * k) / a0;
+	pre_b[1] = 2.0 * (k * k - vh) / a0;
+	pre_b[2] = (vh - vb * k / q + k * k) / a0;
+	pre_a[0] = 1.0;
+	pre_a[1] = 2.0 * (k * k - 1.0) / a0;
+	pre_a[2] = (1.0 - k / q + k * k) / a0;
+
+	k = tan(M_PI * 38.13547087602444 / samplerate);
+	q = 0.5003270373238773;
+	a0 = 1.0 + k / q + k * k;
+	rlb_b[0] = 1.0;
+	rlb_b[1] = -2.0;
+	rlb_b[2] = 1.0;
+	rlb_a[0] = 1.0;
+	rlb_a[1] = 2.0 * (k * k - 1.0) / a0;
+	rlb_a[2] = (1.0 - k / q + k * k) / a0;
+
+	filter_state.assign(channels * 6, 0.0);
+
+	// restart the current block and the loudness windows
+	block_frames = samplerate * block_ms / 1000;
+	block_pos = 0;
+	block_kw_sum = 0.0;
+	block_sq_sum = 0;
+	block_max = INT16_MIN;
+	block_min = INT16_MAX;
+	block_clipped = 0;
+	block_powers_count = 0;
+}
+
+void AudioMonitor::Process(const int16_t *src, size_t samples) {
+	if(channels == 0)
+		return;
+
+	size_t frames = samples / channels;
+	while(frames) {
+		size_t len = std::min(frames, block_frames - block_pos);
+
+		AnalyseSamples(src, len * channels, block_max, block_min, block_sq_sum, block_clipped);
+		block_kw_sum += ApplyKWeighting(src, len, channels, pre_b, pre_a, rlb_b, rlb_a, &filter_state[0]);
+
+		src += len * channels;
+		frames -= len;
+		block_pos += len;
+		if(block_pos == block_frames)
+			FinishBlock();
+	}
+}
+
+void AudioMonitor::FinishBlock() {
+	size_t block = blocks_total++;
+	stats.audio_ms = BlockToMs(blocks_total);
+
+	// peak/RMS/clipping
+	int peak = std::max(-(int) block_min, (int) block_max);
+	if(peak)
+		stats.peak_dbfs = std::max(stats.peak_dbfs, 20 * log10(peak / 32768.0));
+	stats.clipped_samples += block_clipped;
+	double rms = sqrt((double) block_sq_sum / (block_frames * channels)) / 32768.0;
+	double rms_dbfs = rms > 0 ? 20 * log10(rms) : -INFINITY;
+
+	// loudness (momentary: 400ms, short-term: 3s)
+	block_powers[block_powers_index] = block_kw_sum / block_frames;
+	block_powers_index = (block_powers_index + 1) % 30;
+	block_powers_count = std::min(block_powers_count + 1, (size_t) 30);
+
+	if(block_powers_count >= 4) {
+		double power = GetPowerMean(4);
+		stats.momentary_lufs = PowerToLoudness(power);
+		stats.max_momentary_lufs = std::max(stats.max_momentary_lufs, stats.momentary_lufs);
+
+		// gating blocks overlap by 75%
+		if(stats.momentary_lufs >= gating_min_lufs) {
+			size_t bin = std::min((size_t) ((stats.momentary_lufs - gating_min_lufs) / gating_resolution_lu), gating_counts.size() - 1);
+			gating_counts[bin]++;
+			gating_powers[bin] += power;
+		}
+	}
+	if(block_powers_count >= 30)
+		stats.short_term_lufs = PowerToLoudness(GetPowerMean(30));
+
+	// silence alarm
+	if(rms_dbfs < silence_threshold_dbfs) {
+		silent_blocks++;
+		if(!silence_alarm && BlockToMs(silent_blocks) >= silence_alarm_ms) {
+			silence_alarm = true;
+			if(observer) {
+				AUDIO_MONITOR_EVENT event = {AUDIO_MONITOR_EVENT::Type::SilenceStart, BlockToMs(blocks_total - silent_blocks), 0, 0};
+				observer->AudioMonitorEvent(event);
+			}
+		}
+	} else {
+		if(silence_alarm) {
+			silence_alarm = false;
+			stats.silence_ms += BlockToMs(silent_blocks);
+			if(observer) {
+				AUDIO_MONITOR_EVENT event = {AUDIO_MONITOR_EVENT::Type::SilenceEnd, BlockToMs(block - silent_blocks), BlockToMs(silent_blocks), 0};
+				observer->AudioMonitorEvent(event);
+			}
+		}
+		silent_blocks = 0;
+	}
+
+	// clipping alarm
+	if(block_clipped) {
+		if(!clipping_alarm) {
+			clipping_alarm = true;
+			clipping_start_block = block;
+			clipping_samples = 0;
+			if(observer) {
+				AUDIO_MONITOR_EVENT event = {AUDIO_MONITOR_EVENT::Type::ClippingStart, BlockToMs(block), 0, 0};
+				observer->AudioMonitorEvent(event);
+			}
+		}
+		clipping_last_block = block;
+		clipping_samples += block_clipped;
+	} else if(clipping_alarm && BlockToMs(block - clipping_last_block) >= clipping_hold_ms) {
+		clipping_alarm = false;
+		if(observer) {
+			AUDIO_MONITOR_EVENT event = {AUDIO_MONITOR_EVENT::Type::ClippingEnd, BlockToMs(clipping_start_block), BlockToMs(clipping_last_block + 1 - clipping_start_block), clipping_samples};
+			observer->AudioMonitorEvent(event);
+		}
+	}
+
+	block_pos = 0;
+	block_kw_sum = 0.0;
+	block_sq_sum = 0;
+	block_max = INT16_MIN;
+	block_min = INT16_MAX;
+	block_clipped = 0;
+}
+
+double AudioMonitor::GetPowerMean(size_t blocks) const {
+	double sum = 0.0;
+	for(size_t i = 1; i <= blocks; i++)
+		sum += block_powers[(block_powers_index + 30 - i) % 30];
+	return sum / blocks;
+}
+
+double AudioMonitor::GetIntegratedLoudness() const {
+	// absolute gate (by histogram)
+	size_t count = 0;
+	double power = 0.0;
+	for(size_t i = 0; i < gating_counts.size(); i++) {
+		count += gating_counts[i];
+		power += gating_powers[i];
+	}
+	if(count == 0)
+		return -INFINITY;
+
+	// relative gate (10 LU below the absolute-gated loudness)
+	double relative_gate_lufs = PowerToLoudness(power / count) - 10.0;
+	count = 0;
+	power = 0.0;
+	for(size_t i = 0; i < gating_counts.size(); i++) {
+		if(gating_min_lufs + (i + 0.5) * gating_resolution_lu < relative_gate_lufs)
+			continue;
+		count += gating_counts[i];
+		power += gating_powers[i];
+	}
+	return count ? PowerToLoudness(power / count) : -INFINITY;
+}
+
+AUDIO_MONITOR_STATS AudioMonitor::GetStats() const {
+	AUDIO_MONITOR_STATS result = stats;
+	if(silence_alarm)
+		result.silence_ms += BlockToMs(silent_blocks);
+	result.integrated_lufs = GetIntegratedLoudness();
+	return result;
+}
+
+void AudioMonitor::AnalyseSamples(const int16_t *src, size_t samples, int16_t& max, int16_t& min, uint64_t& sq_sum, size_t& clipped) {
+	size_t i = 0;
+
+#if defined(__SSE2__)
+	if(samples >= 8) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i clip_max = _mm_set1_epi16(INT16_MAX);
+		const __m128i clip_min = _mm_set1_epi16(INT16_MIN);
+		__m128i v_max = _mm_set1_epi16(max);
+		__m128i v_min = _mm_set1_epi16(min);
+		__m128i v_sq_sum = zero;
+		size_t clipped_bytes = 0;
+
+		for(; i + 8 <= samples; i += 8) {
+			__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+			v_max = _mm_max_epi16(v_max, v);
+			v_min = _mm_min_epi16(v_min, v);
+
+			// the pairwise sum of squares is at most 2^31, so fits as unsigned
+			__m128i sq = _mm_madd_epi16(v, v);
+			v_sq_sum = _mm_add_epi64(v_sq_sum, _mm_unpacklo_epi32(sq, zero));
+			v_sq_sum = _mm_add_epi64(v_sq_sum, _mm_unpackhi_epi32(sq, zero));
+
+			__m128i clip = _mm_or_si128(_mm_cmpeq_epi16(v, clip_max), _mm_cmpeq_epi16(v, clip_min));
+			clipped_bytes += __builtin_popcount(_mm_movemask_epi8(clip));
+		}
+
+		int16_t maxs[8];
+		int16_t mins[8];
+		uint64_t sq_sums[2];
+		_mm_storeu_si128((__m128i*) maxs, v_max);
+		_mm_storeu_si128((__m128i*) mins, v_min);
+		_mm_storeu_si128((__m128i*) sq_sums, v_sq_sum);
+		for(int j = 0; j < 8; j++) {
+			max = std::max(max, maxs[j]);
+			min = std::min(min, mins[j]);
+		}
+		sq_sum += sq_sums[0] + sq_sums[1];
+		clipped += clipped_bytes / 2;
+	}
+#endif
+
+	for(; i < samples; i++) {
+		int16_t value = src[i];
+		max = std::max(max, value);
+		min = std::min(min, value);
+		sq_sum += (int32_t) value * value;
+		if(value == INT16_MAX || value == INT16_MIN)
+			clipped++;
+	}
+}
+
+double AudioMonitor::ApplyKWeighting(const int16_t *src, size_t frames, int channels, const double *pre_b, const double *pre_a, const double *rlb_b, const double *rlb_a, double *state) {
+	/* Both biquads are applied in direct form I; as the RLB filter input
+	 * equals the pre-filter output, the states can be shared:
+	 * x1, x2 (input), y1, y2 (pre-filter output), z1, z2 (RLB filter output)
+	 */
+	const double scale = 1.0 / 32768.0;
+	double result = 0.0;
+
+#if defined(__SSE2__)
+	// stereo: both channels at once
+	if(channels == 2) {
+		__m128d x1 = _mm_set_pd(state[6], state[0]);
+		__m128d x2 = _mm_set_pd(state[7], state[1]);
+		__m128d y1 = _mm_set_pd(state[8], state[2]);
+		__m128d y2 = _mm_set_pd(state[9], state[3]);
+		__m128d z1 = _mm_set_pd(state[10], state[4]);
+		__m128d z2 = _mm_set_pd(state[11], state[5]);
+		const __m128d pb0 = _mm_set1_pd(pre_b[0]);
+		const __m128d pb1 = _mm_set1_pd(pre_b[1]);
+		const __m128d pb2 = _mm_set1_pd(pre_b[2]);
+		const __m128d pa1 = _mm_set1_pd(pre_a[1]);
+		const __m128d pa2 = _mm_set1_pd(pre_a[2]);
+		const __m128d rb0 = _mm_set1_pd(rlb_b[0]);
+		const __m128d rb1 = _mm_set1_pd(rlb_b[1]);
+		const __m128d rb2 = _mm_set1_pd(rlb_b[2]);
+		const __m128d ra1 = _mm_set1_pd(rlb_a[1]);
+		const __m128d ra2 = _mm_set1_pd(rlb_a[2]);
+		__m128d sum = _mm_setzero_pd();
+
+		for(size_t i = 0; i < frames; i++) {
+			__m128d x = _mm_set_pd(src[i * 2 + 1] * scale, src[i * 2] * scale);
+			__m128d y = _mm_sub_pd(
+					_mm_add_pd(_mm_add_pd(_mm_mul_pd(pb0, x), _mm_mul_pd(pb1, x1)), _mm_mul_pd(pb2, x2)),
+					_mm_add_pd(_mm_mul_pd(pa1, y1), _mm_mul_pd(pa2, y2)));
+			__m128d z = _mm_sub_pd(
+					_mm_add_pd(_mm_add_pd(_mm_mul_pd(rb0, y), _mm_mul_pd(rb1, y1)), _mm_mul_pd(rb2, y2)),
+					_mm_add_pd(_mm_mul_pd(ra1, z1), _mm_mul_pd(ra2, z2)));
+			x2 = x1;
+			x1 = x;
+			y2 = y1;
+			y1 = y;
+			z2 = z1;
+			z1 = z;
+			sum = _mm_add_pd(sum, _mm_mul_pd(z, z));
+		}
+
+		double values[2];
+		_mm_storeu_pd(values, sum);
+		result = values[0] + values[1];
+
+		_mm_storeu_pd(values, x1); state[0] = values[0]; state[6] = values[1];
+		_mm_storeu_pd(values, x2); state[1] = values[0]; state[7] = values[1];
+		_mm_storeu_pd(values, y1); state[2] = values[0]; state[8] = values[1];
+		_mm_storeu_pd(values, y2); state[3] = values[0]; state[9] = values[1];
+		_mm_storeu_pd(values, z1); state[4] = values[0]; state[10] = values[1];
+		_mm_storeu_pd(values, z2); state[5] = values[0]; state[11] = values[1];
+		return result;
+	}
+#endif
+
+	for(int c = 0; c < channels; c++) {
+		double *s = state + c * 6;
+		double x1 = s[0], x2 = s[1], y1 = s[2], y2 = s[3], z1 = s[4], z2 = s[5];
+
+		for(size_t i = 0; i < frames; i++) {
+			double x = src[i * channels + c] * scale;
+			double y = pre_b[0] * x + pre_b[1] * x1 + pre_b[2] * x2 - pre_a[1] * y1 - pre_a[2] * y2;
+			double z = rlb_b[0] * y + rlb_b[1] * y1 + rlb_b[2] * y2 - rlb_a[1] * z1 - rlb_a[2] * z2;
+			x2 = x1;
+			x1 = x;
+			y2 = y1;
+			y1 = y;
+			z2 = z1;
+			z1 = z;
+			result += z * z;
+		}
+
+		s[0] = x1; s[1] = x2; s[2] = y1; s[3] = y2; s[4] = z1; s[5] = z2;
+	}
+	return result;
+}
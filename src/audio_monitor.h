@@ -0,0 +1,145 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUDIO_MONITOR_H_
+#define AUDIO_MONITOR_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+// --- AUDIO_MONITOR_EVENT -----------------------------------------------------------------
+struct AUDIO_MONITOR_EVENT {
+	enum class Type {SilenceStart, SilenceEnd, ClippingStart, ClippingEnd};
+
+	Type type;
+	size_t start_ms;			// in audio time, of the silence/clipping
+	size_t duration_ms;			// on end only
+	size_t clipped_samples;		// on clipping end only
+
+	const char* GetTypeName() const;
+};
+
+
+// --- AUDIO_MONITOR_STATS -----------------------------------------------------------------
+struct AUDIO_MONITOR_STATS {
+	size_t audio_ms;
+	double peak_dbfs;			// -INFINITY, if only digital silence
+	size_t clipped_samples;
+	size_t silence_ms;			// only silences long enough to raise an alarm
+	double momentary_lufs;		// EBU R128 (-INFINITY, if not yet available)
+	double short_term_lufs;
+	double max_momentary_lufs;
+	double integrated_lufs;
+
+	AUDIO_MONITOR_STATS() :
+		audio_ms(0),
+		peak_dbfs(-INFINITY),
+		clipped_samples(0),
+		silence_ms(0),
+		momentary_lufs(-INFINITY),
+		short_term_lufs(-INFINITY),
+		max_momentary_lufs(-INFINITY),
+		integrated_lufs(-INFINITY)
+		{}
+};
+
+
+// --- AudioMonitorObserver -----------------------------------------------------------------
+class AudioMonitorObserver {
+public:
+	virtual ~AudioMonitorObserver() {}
+
+	virtual void AudioMonitorEvent(const AUDIO_MONITOR_EVENT& /*event*/) {}
+};
+
+
+// --- AudioMonitor -----------------------------------------------------------------
+// analyses S16 audio (peak, clipping, silence, EBU R128 loudness) in blocks of 100ms
+class AudioMonitor {
+private:
+	AudioMonitorObserver *observer;
+
+	int samplerate;
+	int channels;
+
+	// K-weighting: pre-filter and RLB high-pass filter (coefficients a0 normalized to 1)
+	double pre_b[3], pre_a[3];
+	double rlb_b[3], rlb_a[3];
+	std::vector<double> filter_state;	// per channel: pre-filter x1, x2, y1, y2; RLB y1, y2
+
+	size_t block_frames;
+	size_t block_pos;
+	double block_kw_sum;		// K-weighted squares, summed over all channels
+	uint64_t block_sq_sum;
+	int16_t block_max;
+	int16_t block_min;
+	size_t block_clipped;
+
+	// K-weighted block powers for the momentary (400ms) and short-term (3s) windows
+	double block_powers[30];
+	size_t block_powers_count;
+	size_t block_powers_index;
+
+	// histogram of the momentary loudness (for the gated integrated loudness)
+	std::vector<uint32_t> gating_counts;
+	std::vector<double> gating_powers;
+
+	size_t blocks_total;
+	size_t silent_blocks;
+	bool silence_alarm;
+	size_t clipping_start_block;
+	size_t clipping_last_block;
+	size_t clipping_samples;
+	bool clipping_alarm;
+
+	AUDIO_MONITOR_STATS stats;
+
+	size_t BlockToMs(size_t block) const {return block * block_ms;}
+	void FinishBlock();
+	double GetPowerMean(size_t blocks) const;
+	double GetIntegratedLoudness() const;
+
+	static double PowerToLoudness(double power) {return power > 0 ? -0.691 + 10 * log10(power) : -INFINITY;}
+	static void AnalyseSamples(const int16_t *src, size_t samples, int16_t& max, int16_t& min, uint64_t& sq_sum, size_t& clipped);
+	static double ApplyKWeighting(const int16_t *src, size_t frames, int channels, const double *pre_b, const double *pre_a, const double *rlb_b, const double *rlb_a, double *state);
+
+	static const size_t block_ms;
+	static const double silence_threshold_dbfs;
+	static const size_t silence_alarm_ms;
+	static const size_t clipping_hold_ms;
+	static const double gating_min_lufs;
+	static const double gating_max_lufs;
+	static const double gating_resolution_lu;
+public:
+	AudioMonitor(AudioMonitorObserver *observer);
+
+	void SetFormat(int samplerate, int channels);
+	void Process(const int16_t *src, size_t samples);
+
+	AUDIO_MONITOR_STATS GetStats() const;
+};
+
+#endif /* AUDIO_MONITOR_H_ */
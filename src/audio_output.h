@@ -21,6 +21,8 @@
 
 #include <string.h>
 
+class BatchedWriter;
+
 
 // --- AudioOutput -----------------------------------------------------------------
 class AudioOutput {
@@ -34,6 +36,10 @@ public:
 	virtual void SetAudioMute(bool /*audio_mute*/) = 0;
 	virtual void SetAudioVolume(double /*audio_volume*/) = 0;
 	virtual bool HasAudioVolumeControl() = 0;
+
+	virtual void SetAudioLatency(size_t /*audio_latency_ms*/) {}	// only for outputs with own playout
+	virtual void SetFixedOutputFormat(bool /*fixed_output_format*/) {}	// only for outputs with own playout
+	virtual void SetBatchedWriter(BatchedWriter* /*writer*/) {}		// only for outputs to stdout
 };
 
 
@@ -0,0 +1,192 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "batched_writer.h"
+
+
+// --- BatchedWriter -----------------------------------------------------------------
+const size_t BatchedWriter::default_batch_size = 65536;
+const size_t BatchedWriter::default_flush_latency_ms = 100;
+const size_t BatchedWriter::batches_per_mapping = 16;
+
+BatchedWriter::BatchedWriter(int fd, size_t batch_size, size_t flush_latency_ms) {
+	this->fd = fd;
+	flush_latency = std::chrono::milliseconds(flush_latency_ms);
+
+	// use whole pages
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	this->batch_size = (std::max(batch_size, (size_t) 1) + page_size - 1) / page_size * page_size;
+
+	mapping = nullptr;
+	mapping_len = 0;
+	mapping_used = 0;
+
+	batch = nullptr;
+	batch_len = 0;
+
+	/* If the output is a pipe, vmsplice is used to just map the batch pages
+	 * into the pipe. As the pages may then even be spliced on by the reader,
+	 * they must never be modified again - so each batch uses fresh pages.
+	 * To not need two more syscalls per batch, several batches are mapped
+	 * at once and only unmapped after all of them were gifted (the pipe
+	 * keeps its own page references).
+	 */
+	use_vmsplice = false;
+#ifdef __linux__
+	struct stat fd_stat;
+	if(fstat(fd, &fd_stat) == 0 && S_ISFIFO(fd_stat.st_mode))
+		use_vmsplice = true;
+#endif
+
+	stats.vmsplice = use_vmsplice;
+	fprintf(stderr, "BatchedWriter: using batches of %zu bytes (%s); flush latency: %zu ms\n",
+			this->batch_size, use_vmsplice ? "vmsplice" : "write", flush_latency_ms);
+}
+
+BatchedWriter::~BatchedWriter() {
+	FlushBatch();
+	UnmapBatches();
+
+	fprintf(stderr, "BatchedWriter: %zu bytes written in %zu batches using %zu syscalls (%zu %s, %zu mmap/munmap)\n",
+			stats.bytes, stats.batches, stats.syscalls, stats.syscalls - stats.mapping_syscalls, use_vmsplice ? "vmsplice" : "write", stats.mapping_syscalls);
+}
+
+void BatchedWriter::Write(const uint8_t *data, size_t len) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	while(len) {
+		if(batch_len == 0) {
+			if(!batch)
+				MapBatch();
+			batch_start = std::chrono::steady_clock::now();
+		}
+
+		size_t copy_len = std::min(len, batch_size - batch_len);
+		memcpy(batch + batch_len, data, copy_len);
+		batch_len += copy_len;
+		data += copy_len;
+		len -= copy_len;
+
+		if(batch_len == batch_size)
+			FlushBatch();
+	}
+
+	if(IsFlushDue())
+		FlushBatch();
+}
+
+void BatchedWriter::Flush() {
+	std::lock_guard<std::mutex> lock(mutex);
+	FlushBatch();
+}
+
+void BatchedWriter::FlushIfDue() {
+	std::lock_guard<std::mutex> lock(mutex);
+	if(IsFlushDue())
+		FlushBatch();
+}
+
+bool BatchedWriter::IsFlushDue() {
+	return batch_len && std::chrono::steady_clock::now() - batch_start >= flush_latency;
+}
+
+void BatchedWriter::FlushBatch() {
+	if(batch_len == 0)
+		return;
+
+	// a gifted batch must not be reused
+	bool gifted = use_vmsplice;
+
+	if(WriteBatch(batch, batch_len)) {
+		stats.bytes += batch_len;
+		stats.batches++;
+	}
+	batch_len = 0;
+
+	// the pages are released together with the rest of the mapping
+	if(gifted)
+		batch = nullptr;
+}
+
+void BatchedWriter::MapBatch() {
+	// use the next unused batch of the current mapping, if any
+	if(mapping && mapping_used + batch_size <= mapping_len) {
+		batch = mapping + mapping_used;
+		mapping_used += batch_size;
+		return;
+	}
+
+	UnmapBatches();
+
+	// only gifted batches need fresh pages
+	size_t len = batch_size * (use_vmsplice ? batches_per_mapping : 1);
+	void *result = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	stats.syscalls++;
+	stats.mapping_syscalls++;
+	if(result == MAP_FAILED)
+		throw std::runtime_error("BatchedWriter: error while mapping batches: " + std::string(strerror(errno)));
+
+	mapping = (uint8_t*) result;
+	mapping_len = len;
+	mapping_used = batch_size;
+	batch = mapping;
+}
+
+void BatchedWriter::UnmapBatches() {
+	if(mapping) {
+		munmap(mapping, mapping_len);
+		stats.syscalls++;
+		stats.mapping_syscalls++;
+		mapping = nullptr;
+		batch = nullptr;
+	}
+}
+
+bool BatchedWriter::WriteBatch(const uint8_t *data, size_t len) {
+	while(len) {
+		ssize_t written;
+#ifdef __linux__
+		if(use_vmsplice) {
+			// gifting requires whole pages
+			struct iovec iov = {(void*) data, len};
+			written = vmsplice(fd, &iov, 1, (len % sysconf(_SC_PAGESIZE)) ? 0 : SPLICE_F_GIFT);
+			stats.syscalls++;
+			if(written == -1 && (errno == EINVAL || errno == ENOSYS)) {
+				fprintf(stderr, "BatchedWriter: vmsplice not supported, falling back to write\n");
+				use_vmsplice = false;
+				stats.vmsplice = false;
+				continue;
+			}
+		} else
+#endif
+		{
+			written = write(fd, data, len);
+			stats.syscalls++;
+		}
+
+		if(written == -1) {
+			if(errno == EINTR)
+				continue;
+			perror("BatchedWriter: error while writing batch");
+			return false;
+		}
+		data += written;
+		len -= written;
+	}
+	return true;
+}
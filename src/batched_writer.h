@@ -0,0 +1,91 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BATCHED_WRITER_H_
+#define BATCHED_WRITER_H_
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <chrono>
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+
+// --- BATCHED_WRITER_STATS -----------------------------------------------------------------
+struct BATCHED_WRITER_STATS {
+	size_t bytes;
+	size_t batches;
+	size_t syscalls;		// incl. retries after partial writes and (un)mapping
+	size_t mapping_syscalls;
+	bool vmsplice;
+
+	BATCHED_WRITER_STATS() : bytes(0), batches(0), syscalls(0), mapping_syscalls(0), vmsplice(false) {}
+};
+
+
+// --- BatchedWriter -----------------------------------------------------------------
+// collects output into page-aligned batches, which are written at once (using vmsplice, if a pipe)
+class BatchedWriter {
+private:
+	std::mutex mutex;	// writes may come from different threads (e.g. tee output sinks)
+	int fd;
+	size_t batch_size;
+	std::chrono::milliseconds flush_latency;
+
+	uint8_t *mapping;		// room for several batches, if gifted
+	size_t mapping_len;
+	size_t mapping_used;
+
+	uint8_t *batch;
+	size_t batch_len;
+	std::chrono::steady_clock::time_point batch_start;
+
+	bool use_vmsplice;
+	BATCHED_WRITER_STATS stats;
+
+	void MapBatch();
+	void UnmapBatches();
+	bool WriteBatch(const uint8_t *data, size_t len);
+	void FlushBatch();
+	bool IsFlushDue();
+public:
+	BatchedWriter(int fd, size_t batch_size, size_t flush_latency_ms);
+	~BatchedWriter();
+
+	void Write(const uint8_t *data, size_t len);
+	void Flush();
+	void FlushIfDue();	// to be called regularly, so that the max latency also applies when no further output follows
+
+	const BATCHED_WRITER_STATS& GetStats() {return stats;}
+
+	static const size_t default_batch_size;
+	static const size_t default_flush_latency_ms;
+	static const size_t batches_per_mapping;
+};
+
+#endif /* BATCHED_WRITER_H_ */
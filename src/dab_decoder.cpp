@@ -18,6 +18,33 @@
 
 #include "dab_decoder.h"
 
+// --- MP2HandlePool -----------------------------------------------------------------
+MP2HandlePool::MP2HandlePool() : HandlePool(4, mpg123_delete) {
+	// process-wide init
+	int mpg_result = mpg123_init();
+	if(mpg_result != MPG123_OK)
+		throw std::runtime_error("MP2HandlePool: error while mpg123_init: " + std::string(mpg123_plain_strerror(mpg_result)));
+
+	// ensure features
+	if(!mpg123_feature(MPG123_FEATURE_OUTPUT_32BIT))
+		throw std::runtime_error("MP2HandlePool: no 32bit output support!");
+	if(!mpg123_feature(MPG123_FEATURE_DECODE_LAYER2))
+		throw std::runtime_error("MP2HandlePool: no Layer II decode support!");
+}
+
+MP2HandlePool::~MP2HandlePool() {
+	// idle handles have to be deleted before the process-wide exit
+	Clear();
+	mpg123_exit();
+}
+
+MP2HandlePool& MP2HandlePool::GetInstance() {
+	static MP2HandlePool instance;
+	return instance;
+}
+
+
+
 // --- MP2Decoder -----------------------------------------------------------------
 // from ETSI TS 103 466, table 4 (= ISO/IEC 11172-3, table B.2a):
 const int MP2Decoder::table_nbal_48a[] = {
@@ -46,65 +73,76 @@ const int MP2Decoder::sblimits[] = {
 		sizeof(table_nbal_48b) / sizeof(int),
 		sizeof(table_nbal_24) / sizeof(int),
 };
+// from ISO/IEC 11172-3, 2.4.2.3 (Layer II only):
+const int MP2Decoder::table_bitrates_10[] = {
+		0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 0
+};
+// header bits affecting the CRC coverage: ID, protection_bit, bitrate_index, mode, mode_extension
+const unsigned long MP2Decoder::crc_header_mask = 0x0019F0F0;
 
 
 MP2Decoder::MP2Decoder(SubchannelSinkObserver* observer) : SubchannelSink(observer, "mp2") {
 	scf_crc_len = -1;
 	lsf = false;
 
+	InitCRCLayouts();
+	crc_header_key = ~0UL;	// never matches a masked header
+	crc_layout = nullptr;
 
-	int mpg_result;
-
-	// init
-	mpg_result = mpg123_init();
-	if(mpg_result != MPG123_OK)
-		throw std::runtime_error("MP2Decoder: error while mpg123_init: " + std::string(mpg123_plain_strerror(mpg_result)));
-
-	// ensure features
-	if(!mpg123_feature(MPG123_FEATURE_OUTPUT_32BIT))
-		throw std::runtime_error("MP2Decoder: no 32bit output support!");
-	if(!mpg123_feature(MPG123_FEATURE_DECODE_LAYER2))
-		throw std::runtime_error("MP2Decoder: no Layer II decode support!");
 
-	handle = mpg123_new(nullptr, &mpg_result);
-	if(!handle)
-		throw std::runtime_error("MP2Decoder: error while mpg123_new: " + std::string(mpg123_plain_strerror(mpg_result)));
+	std::chrono::steady_clock::time_point setup_start = std::chrono::steady_clock::now();
+	int mpg_result;
 
-	fprintf(stderr, "MP2Decoder: using decoder '%s'.\n", mpg123_current_decoder(handle));
+	// reuse an idle handle, if available (allowed formats/params are kept)
+	bool reused = MP2HandlePool::GetInstance().Acquire("", handle);
 
+	// delete the handle, if anything below fails (as the destructor is then not called)
+	std::unique_ptr<mpg123_handle, decltype(&mpg123_delete)> handle_guard(reused ? handle : nullptr, mpg123_delete);
+	if(!reused) {
+		handle = mpg123_new(nullptr, &mpg_result);
+		if(!handle)
+			throw std::runtime_error("MP2Decoder: error while mpg123_new: " + std::string(mpg123_plain_strerror(mpg_result)));
+		handle_guard.reset(handle);
 
-	// set allowed formats
-	mpg_result = mpg123_format_none(handle);
-	if(mpg_result != MPG123_OK)
-		throw std::runtime_error("MP2Decoder: error while mpg123_format_none: " + std::string(mpg123_plain_strerror(mpg_result)));
+		// set allowed formats
+		mpg_result = mpg123_format_none(handle);
+		if(mpg_result != MPG123_OK)
+			throw std::runtime_error("MP2Decoder: error while mpg123_format_none: " + std::string(mpg123_plain_strerror(mpg_result)));
 
-	mpg_result = mpg123_format(handle, 48000, MPG123_MONO | MPG123_STEREO, MPG123_ENC_SIGNED_16);
-	if(mpg_result != MPG123_OK)
-		throw std::runtime_error("MP2Decoder: error while mpg123_format #1: " + std::string(mpg123_plain_strerror(mpg_result)));
+		mpg_result = mpg123_format(handle, 48000, MPG123_MONO | MPG123_STEREO, MPG123_ENC_SIGNED_16);
+		if(mpg_result != MPG123_OK)
+			throw std::runtime_error("MP2Decoder: error while mpg123_format #1: " + std::string(mpg123_plain_strerror(mpg_result)));
 
-	mpg_result = mpg123_format(handle, 24000, MPG123_MONO | MPG123_STEREO, MPG123_ENC_SIGNED_16);
-	if(mpg_result != MPG123_OK)
-		throw std::runtime_error("MP2Decoder: error while mpg123_format #2: " + std::string(mpg123_plain_strerror(mpg_result)));
+		mpg_result = mpg123_format(handle, 24000, MPG123_MONO | MPG123_STEREO, MPG123_ENC_SIGNED_16);
+		if(mpg_result != MPG123_OK)
+			throw std::runtime_error("MP2Decoder: error while mpg123_format #2: " + std::string(mpg123_plain_strerror(mpg_result)));
 
-	// disable resync limit
-	mpg_result = mpg123_param(handle, MPG123_RESYNC_LIMIT, -1, 0);
-	if(mpg_result != MPG123_OK)
-		throw std::runtime_error("MP2Decoder: error while mpg123_param: " + std::string(mpg123_plain_strerror(mpg_result)));
+		// disable resync limit
+		mpg_result = mpg123_param(handle, MPG123_RESYNC_LIMIT, -1, 0);
+		if(mpg_result != MPG123_OK)
+			throw std::runtime_error("MP2Decoder: error while mpg123_param: " + std::string(mpg123_plain_strerror(mpg_result)));
+	}
 
+	// (re)open feed - this also resets any decoder state
 	mpg_result = mpg123_open_feed(handle);
 	if(mpg_result != MPG123_OK)
 		throw std::runtime_error("MP2Decoder: error while mpg123_open_feed: " + std::string(mpg123_plain_strerror(mpg_result)));
+
+	double setup_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setup_start).count();
+	fprintf(stderr, "MP2Decoder: using decoder '%s' (%s handle, set up in %.3f ms)\n", mpg123_current_decoder(handle), reused ? "reused" : "new", setup_ms);
+
+	handle_guard.release();
 }
 
 MP2Decoder::~MP2Decoder() {
-	if(handle) {
-		int mpg_result = mpg123_close(handle);
-		if(mpg_result != MPG123_OK)
-			fprintf(stderr, "MP2Decoder: error while mpg123_close: %s\n", mpg123_plain_strerror(mpg_result));
+	int mpg_result = mpg123_close(handle);
+	if(mpg_result != MPG123_OK) {
+		fprintf(stderr, "MP2Decoder: error while mpg123_close: %s\n", mpg123_plain_strerror(mpg_result));
+		mpg123_delete(handle);
+		return;
 	}
 
-	mpg123_delete(handle);
-	mpg123_exit();
+	MP2HandlePool::GetInstance().Release("", handle);
 }
 
 void MP2Decoder::Feed(const uint8_t *data, size_t len) {
@@ -154,6 +192,7 @@ size_t MP2Decoder::DecodeFrame(uint8_t **data) {
 	// check CRC (MP2's CRC only - not DAB's ScF-CRC)
 	if(!CheckCRC(header, body_data, body_bytes)) {
 		observer->AudioError("CRC");
+		ForwardUntouchedStreamGap(lsf ? 48 : 24);
 		// no PAD reset, as not covered by CRC
 		return 0;
 	}
@@ -174,65 +213,89 @@ void MP2Decoder::ProcessUntouchedStream(const unsigned long& header, const uint8
 	if(uscs.empty())
 		return;
 
-	// adjust buffer size, if needed
-	if(frame.size() != body_bytes + 4)
-		frame.resize(body_bytes + 4);
-
-	// reassemble MP2 frame
-	frame[0] = (header >> 24) & 0xFF;
-	frame[1] = (header >> 16) & 0xFF;
-	frame[2] = (header >> 8) & 0xFF;
-	frame[3] = header & 0xFF;
-	memcpy(&frame[4], body_data, body_bytes);
+	// reassemble MP2 frame - the body is passed on without copying
+	frame_header[0] = (header >> 24) & 0xFF;
+	frame_header[1] = (header >> 16) & 0xFF;
+	frame_header[2] = (header >> 8) & 0xFF;
+	frame_header[3] = header & 0xFF;
+
+	UNTOUCHED_STREAM_PART parts[2] = {
+			{frame_header, sizeof(frame_header)},
+			{body_data, body_bytes}
+	};
+	ForwardUntouchedStream(parts, 2, lsf ? 48 : 24);
+}
 
-	ForwardUntouchedStream(&frame[0], frame.size(), lsf ? 48 : 24);
+void MP2Decoder::InitCRCLayouts() {
+	for(int table_index = 0; table_index < 3; table_index++) {
+		const int* table_nbal = tables_nbal[table_index];
+		int sblimit = sblimits[table_index];
+
+		for(int nch = 1; nch <= 2; nch++) {
+			for(int bound_index = 0; bound_index < 5; bound_index++) {
+				MP2_CRC_LAYOUT& layout = crc_layouts[table_index][nch - 1][bound_index];
+				layout.alloc_bits = 0;
+				layout.fields = 0;
+
+				int bound = bound_index < 4 ? std::min((bound_index + 1) * 4, sblimit) : sblimit;
+				for(int sb = 0; sb < bound; sb++) {
+					for(int ch = 0; ch < nch; ch++) {
+						layout.field_nbal[layout.fields] = table_nbal[sb];
+						layout.field_scfsi_bits[layout.fields] = 2;
+						layout.alloc_bits += table_nbal[sb];
+						layout.fields++;
+					}
+				}
+				for(int sb = bound; sb < sblimit; sb++) {
+					layout.field_nbal[layout.fields] = table_nbal[sb];
+					layout.field_scfsi_bits[layout.fields] = 2 * nch;
+					layout.alloc_bits += table_nbal[sb];
+					layout.fields++;
+				}
+			}
+		}
+	}
 }
 
-bool MP2Decoder::CheckCRC(const unsigned long& header, const uint8_t *body_data, const size_t& body_bytes) {
-	mpg123_frameinfo info;
-	int mpg_result = mpg123_info(handle, &info);
-	if(mpg_result != MPG123_OK)
-		throw std::runtime_error("MP2Decoder: error while mpg123_info: " + std::string(mpg123_plain_strerror(mpg_result)));
+void MP2Decoder::UpdateCRCLayout(const unsigned long& header) {
+	crc_header_key = header & crc_header_mask;
 
 	// abort, if no CRC present (though required by DAB)
-	if(!(info.flags & MPG123_CRC))
-		return false;
+	if(header & 0x00010000) {
+		crc_layout = nullptr;
+		return;
+	}
+
+	int mode = (header >> 6) & 0x03;
+	int mode_ext = (header >> 4) & 0x03;
+	bool mpeg_1_0 = ((header >> 19) & 0x03) == 0x03;
 
 	// select matching nbal table
-	int nch = info.mode == MPG123_M_MONO ? 1 : 2;
-	int table_index = info.version == MPG123_1_0 ? ((info.bitrate / nch) >= 56 ? 0 : 1) : 2;
-	const int* table_nbal = tables_nbal[table_index];
+	int nch = mode == 0x03 ? 1 : 2;
+	int table_index = mpeg_1_0 ? ((table_bitrates_10[(header >> 12) & 0x0F] / nch) >= 56 ? 0 : 1) : 2;
+	int bound_index = mode == 0x01 ? mode_ext : 4;
+
+	crc_layout = &crc_layouts[table_index][nch - 1][bound_index];
+}
+
+bool MP2Decoder::CheckCRC(const unsigned long& header, const uint8_t *body_data, const size_t& body_bytes) {
+	// the layout only changes along with the relevant header bits
+	if((header & crc_header_mask) != crc_header_key)
+		UpdateCRCLayout(header);
+
+	if(!crc_layout)
+		return false;
 
 	// count body bits covered by CRC (= allocation + ScFSI)
 	BitReader br(body_data + CalcCRC::CRCLen, body_bytes - CalcCRC::CRCLen);
-	size_t body_crc_len = 0;
-	int sblimit = sblimits[table_index];
-	int bound = info.mode == MPG123_M_JOINT ? (info.mode_ext + 1) * 4 : sblimit;
-	for(int sb = 0; sb < bound; sb++) {
-		for(int ch = 0; ch < nch; ch++) {
-			int nbal = table_nbal[sb];
-			body_crc_len += nbal;
-
-			int index;
-			if(!br.GetBits(index, nbal))
-				return false;
-
-			if(index)
-				body_crc_len += 2;
-		}
-	}
-	for(int sb = bound; sb < sblimit; sb++) {
-		int nbal = table_nbal[sb];
-		body_crc_len += nbal;
-
+	size_t body_crc_len = crc_layout->alloc_bits;
+	for(size_t field = 0; field < crc_layout->fields; field++) {
 		int index;
-		if(!br.GetBits(index, nbal))
+		if(!br.GetBits(index, crc_layout->field_nbal[field]))
 			return false;
 
-		for(int ch = 0; ch < nch; ch++) {
-			if(index)
-				body_crc_len += 2;
-		}
+		if(index)
+			body_crc_len += crc_layout->field_scfsi_bits[field];
 	}
 
 	// calc CRC
@@ -305,6 +368,7 @@ void MP2Decoder::ProcessFormat() {
 	format.mode = mode;
 	format.bitrate_kbps = info.bitrate;
 	observer->FormatChange(format);
+	ForwardUntouchedStreamAudioFormat(format);
 
 	observer->StartAudio(info.rate, info.mode != MPG123_M_MONO ? 2 : 1);
 }
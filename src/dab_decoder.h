@@ -22,6 +22,8 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <chrono>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -35,6 +37,26 @@
 #include "tools.h"
 
 
+// --- MP2HandlePool -----------------------------------------------------------------
+class MP2HandlePool : public HandlePool<mpg123_handle*> {
+private:
+	MP2HandlePool();
+public:
+	~MP2HandlePool();
+
+	static MP2HandlePool& GetInstance();
+};
+
+
+// --- MP2_CRC_LAYOUT -----------------------------------------------------------------
+struct MP2_CRC_LAYOUT {
+	size_t alloc_bits;					// len of all allocation fields
+	size_t fields;
+	uint8_t field_nbal[2 * 32];			// len of each allocation field (in bitstream order)
+	uint8_t field_scfsi_bits[2 * 32];	// ScFSI len, if the field's allocation is non-zero
+};
+
+
 // --- MP2Decoder -----------------------------------------------------------------
 class MP2Decoder : public SubchannelSink {
 private:
@@ -42,7 +64,14 @@ private:
 
 	int scf_crc_len;
 	bool lsf;
-	std::vector<uint8_t> frame;
+	uint8_t frame_header[4];
+
+	MP2_CRC_LAYOUT crc_layouts[3][2][5];	// [table index][nch - 1][joint stereo: mode_ext / else: 4]
+	unsigned long crc_header_key;
+	const MP2_CRC_LAYOUT* crc_layout;		// nullptr, if no CRC present
+
+	void InitCRCLayouts();
+	void UpdateCRCLayout(const unsigned long& header);
 
 	void ProcessFormat();
 	void ProcessUntouchedStream(const unsigned long& header, const uint8_t *body_data, size_t body_bytes);
@@ -54,6 +83,8 @@ private:
 	static const int table_nbal_24[];
 	static const int* tables_nbal[];
 	static const int sblimits[];
+	static const int table_bitrates_10[];
+	static const unsigned long crc_header_mask;
 public:
 	MP2Decoder(SubchannelSinkObserver* observer);
 	~MP2Decoder();
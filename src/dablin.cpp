@@ -46,13 +46,22 @@ static void usage(const char* exe) {
 					"  -p            Output raw PCM to stdout instead of using SDL\n"
 					"  -w            Output RIFF WAVE with PCM to stdout instead of using SDL (useful only on Little Endian)\n"
 					"  -u            Output untouched audio stream to stdout instead of using SDL\n"
+					"  -b <ms>       Target latency of the SDL output in ms (default: 125)\n"
+					"  -O            Fix the SDL output to 48 kHz stereo (no device reopen on service switch)\n"
+					"  -B <bytes>    Batch output to stdout (pages written at once; vmsplice, if a pipe)\n"
+					"  -T <ms>       Max latency of batched output to stdout in ms (default: 100)\n"
+					"  -a <output>   Additional audio output: \"sdl\", \"pcm:<file>\", \"wav:<file>\" (can be used repeatedly)\n"
+					"  -H <port>     Serve untouched audio streams via HTTP on port (or <ip>:<port>; default IP: %s); current service at \"/\", any service at \"/<sid>\"\n"
+					"  -t <ip:port>  Send untouched audio streams of all services via RTP (to port + 2 * sub-channel ID)\n"
 					"  -I            Don't catch up on stream after interruption\n"
 					"  -F            Disable dynamic FIC messages (dynamic PTY, announcements)\n"
+					"  -E <dir>      Use ensemble cache directory for instant start (requires DAB live source)\n"
 					"  file          Input file to be played (stdin, if not specified)\n",
 					EnsembleSource::FORMAT_ETI.c_str(),
 					EnsembleSource::FORMAT_EDI.c_str(),
 					DABLiveETISource::TYPE_DAB2ETI.c_str(),
-					DABLiveETISource::TYPE_ETI_CMDLINE.c_str()
+					DABLiveETISource::TYPE_ETI_CMDLINE.c_str(),
+					HTTPStreamer::default_address.c_str()
 			);
 	exit(1);
 }
@@ -75,7 +84,7 @@ int main(int argc, char **argv) {
 
 	// option args
 	int c;
-	while((c = getopt(argc, argv, "hf:c:l:d:D:g:Gs:x:1pwuIFr:R:")) != -1) {
+	while((c = getopt(argc, argv, "hf:c:l:d:D:g:Gs:x:1pwub:OB:T:a:H:t:IFE:r:R:")) != -1) {
 		switch(c) {
 		case 'h':
 			usage(argv[0]);
@@ -132,12 +141,42 @@ int main(int argc, char **argv) {
 		case 'u':
 			options.untouched_output = true;
 			break;
+		case 'b':
+			options.audio_latency_ms = strtol(optarg, nullptr, 0);
+			if(options.audio_latency_ms == 0 || options.audio_latency_ms > 10000)
+				usage(argv[0]);
+			break;
+		case 'O':
+			options.fixed_output_format = true;
+			break;
+		case 'B':
+			options.output_batch_size = strtol(optarg, nullptr, 0);
+			if(options.output_batch_size == 0)
+				usage(argv[0]);
+			break;
+		case 'T':
+			options.output_flush_latency_ms = strtol(optarg, nullptr, 0);
+			if(options.output_flush_latency_ms == 0 || options.output_flush_latency_ms > 10000)
+				usage(argv[0]);
+			break;
+		case 'a':
+			options.extra_outputs.push_back(optarg);
+			break;
+		case 'H':
+			options.http_stream_bind = optarg;
+			break;
+		case 't':
+			options.rtp_destination = optarg;
+			break;
 		case 'I':
 			options.disable_int_catch_up = true;
 			break;
 		case 'F':
 			options.disable_dyn_fic_msgs = true;
 			break;
+		case 'E':
+			options.ensemble_cache_dir = optarg;
+			break;
 		case '?':
 		default:
 			usage(argv[0]);
@@ -161,6 +200,10 @@ int main(int argc, char **argv) {
 			fprintf(stderr, "If a channel is selected, DAB live source must be used!\n");
 			usage(argv[0]);
 		}
+		if(!options.ensemble_cache_dir.empty()) {
+			fprintf(stderr, "If an ensemble cache directory is selected, DAB live source must be used!\n");
+			usage(argv[0]);
+		}
 	} else {
 		if(options.source_format != EnsembleSource::FORMAT_ETI) {
 			fprintf(stderr, "A DAB live source can only be used with ETI source format!\n");
@@ -198,6 +241,38 @@ int main(int argc, char **argv) {
 		fprintf(stderr, "No more than one output option can be specified!\n");
 		usage(argv[0]);
 	}
+	for(const std::string& extra_output : options.extra_outputs) {
+		AudioOutputType audio_output_type;
+		std::string filename;
+		if(!EnsemblePlayer::ParseAudioOutput(extra_output, audio_output_type, filename)) {
+			fprintf(stderr, "The additional audio output '%s' is not supported!\n", extra_output.c_str());
+			usage(argv[0]);
+		}
+		if(options.untouched_output) {
+			fprintf(stderr, "Additional audio outputs cannot be used with untouched output!\n");
+			usage(argv[0]);
+		}
+		if(audio_output_type == AudioOutputType::SDL && !options.pcm_output && !options.wav_output) {
+			fprintf(stderr, "SDL output is already used as main output!\n");
+			usage(argv[0]);
+		}
+	}
+	if(!options.http_stream_bind.empty()) {
+		std::string address;
+		int port;
+		if(!HTTPStreamer::ParseBindAddress(options.http_stream_bind, address, port)) {
+			fprintf(stderr, "The HTTP stream address '%s' is not valid!\n", options.http_stream_bind.c_str());
+			usage(argv[0]);
+		}
+	}
+	if(!options.rtp_destination.empty()) {
+		std::string address;
+		int port;
+		if(!RTPSender::ParseDestination(options.rtp_destination, address, port) || port + 2 * 63 > 65535) {
+			fprintf(stderr, "The RTP destination '%s' is not valid!\n", options.rtp_destination.c_str());
+			usage(argv[0]);
+		}
+	}
 
 
 	// at most one param needed!
@@ -225,6 +300,7 @@ int main(int argc, char **argv) {
 // --- DABlinText -----------------------------------------------------------------
 DABlinText::DABlinText(DABlinTextOptions options) {
 	this->options = options;
+	first_found_service_adopted = false;
 
 	// set XTerm window title to version string
 	fprintf(stderr, "\x1B]0;" "DABlin v" DABLIN_VERSION "\a");
@@ -243,6 +319,31 @@ DABlinText::DABlinText(DABlinTextOptions options) {
 		ensemble_player = new ETIPlayer(audio_output_type, options.disable_int_catch_up, this);
 	else
 		ensemble_player = new EDIPlayer(audio_output_type, options.disable_int_catch_up, this);
+	for(const std::string& extra_output : options.extra_outputs) {
+		AudioOutputType audio_output_type;
+		std::string filename;
+		EnsemblePlayer::ParseAudioOutput(extra_output, audio_output_type, filename);
+		ensemble_player->AddAudioOutput(audio_output_type, filename);
+	}
+	if(options.audio_latency_ms)
+		ensemble_player->SetAudioLatency(options.audio_latency_ms);
+	if(options.fixed_output_format)
+		ensemble_player->SetFixedOutputFormat(true);
+	if(options.output_batch_size)
+		ensemble_player->EnableBatchedOutput(options.output_batch_size, options.output_flush_latency_ms);
+
+	http_streamer = nullptr;
+	if(!options.http_stream_bind.empty()) {
+		std::string address;
+		int port;
+		HTTPStreamer::ParseBindAddress(options.http_stream_bind, address, port);
+		http_streamer = new HTTPStreamer(address, port);
+		ensemble_player->AddServiceUntouchedStreamConsumer(http_streamer->AddStream("/"));
+	}
+
+	rtp_sender = nullptr;
+	if(!options.rtp_destination.empty())
+		rtp_sender = new RTPSender(RTPSender::default_ttl);
 
 	// set initial sub-channel, if desired
 	if(options.initial_subchid_dab != AUDIO_SERVICE::subchid_none) {
@@ -274,15 +375,38 @@ DABlinText::DABlinText(DABlinTextOptions options) {
 	}
 
 	fic_decoder = new FICDecoder(this, options.disable_dyn_fic_msgs);
+
+	// speculatively start with cached ensemble, if available
+	if(!options.ensemble_cache_dir.empty())
+		fic_decoder->LoadCache(FICDecoder::GetCacheFilename(options.ensemble_cache_dir, options.initial_channel));
 }
 
 DABlinText::~DABlinText() {
 	DoExit();
 	delete ensemble_source;
+
+	if(!options.ensemble_cache_dir.empty())
+		fic_decoder->SaveCache(FICDecoder::GetCacheFilename(options.ensemble_cache_dir, options.initial_channel));
+
 	delete ensemble_player;
+	for(auto& service_player : service_players)
+		delete service_player.second;
+	delete http_streamer;
+	delete rtp_sender;
 	delete fic_decoder;
 }
 
+void DABlinText::EnsembleProcessFrame(const uint8_t *data) {
+	ensemble_player->ProcessFrame(data);
+
+	for(auto& service_player : service_players)
+		service_player.second->ProcessFrame(data);
+
+	// send the packets of all services at once
+	if(rtp_sender)
+		rtp_sender->Flush();
+}
+
 void DABlinText::EnsembleUpdateProgress(const ENSEMBLE_PROGRESS& progress) {
 	// compensate cursor movement
 	std::string format = "\x1B[34m" "%s" "\x1B[0m";
@@ -294,17 +418,23 @@ void DABlinText::EnsembleUpdateProgress(const ENSEMBLE_PROGRESS& progress) {
 void DABlinText::FICChangeService(const LISTED_SERVICE& service) {
 //	fprintf(stderr, "### FICChangeService\n");
 
-	std::string label = FICDecoder::ConvertLabelToUTF8(service.label, nullptr);
+	// the service may already be listed before its label is present
+	bool label_present = !service.label.IsNone();
+	std::string label = label_present ? FICDecoder::ConvertLabelToUTF8(service.label, nullptr) : ("SId " + StringTools::IntToHex(service.sid, 4));
+
+	if((rtp_sender || http_streamer) && !service.audio_service.IsNone())
+		UpdateServicePlayer(service);
 
 	// if first found service requested, adopt service params (for possible later changes)
 	if(options.initial_first_found_service) {
 		options.initial_sid = service.sid;
 		options.initial_scids = service.scids;
 		options.initial_first_found_service = false;
+		first_found_service_adopted = true;
 	}
 
 	// abort, if no/not initial service
-	if(!(label == options.initial_label || (service.sid == options.initial_sid && service.scids == options.initial_scids)))
+	if(!((label_present && label == options.initial_label) || (service.sid == options.initial_sid && service.scids == options.initial_scids)))
 		return;
 
 	// if the audio service changed, switch
@@ -315,6 +445,122 @@ void DABlinText::FICChangeService(const LISTED_SERVICE& service) {
 	fprintf(stderr, "\x1B]0;" "%s - DABlin" "\a", label.c_str());
 }
 
+void DABlinText::FICResetEnsemble() {
+	// stop the service started from the cache (unless a sub-channel was requested), until the actual services are listed
+	if(options.initial_subchid_dab == AUDIO_SERVICE::subchid_none && options.initial_subchid_dab_plus == AUDIO_SERVICE::subchid_none) {
+		ensemble_player->SetAudioService(AUDIO_SERVICE());
+
+		// set XTerm window title to version string
+		fprintf(stderr, "\x1B]0;" "DABlin v" DABLIN_VERSION "\a");
+	}
+
+	for(auto& service_player : service_players)
+		delete service_player.second;
+	service_players.clear();
+	http_service_subchids.clear();
+
+	// the first found service must be found again
+	if(first_found_service_adopted) {
+		options.initial_first_found_service = true;
+		first_found_service_adopted = false;
+	}
+}
+
+void DABlinText::UpdateServicePlayer(const LISTED_SERVICE& service) {
+	const AUDIO_SERVICE& audio_service = service.audio_service;
+
+	DABlinTextServicePlayer*& service_player = service_players[audio_service.subchid];
+	if(service_player) {
+		service_player->SetAudioService(audio_service);
+	} else {
+		service_player = new DABlinTextServicePlayer(options.source_format, audio_service);
+
+		if(rtp_sender) {
+			std::string address;
+			int port;
+			RTPSender::ParseDestination(options.rtp_destination, address, port);
+			port += 2 * audio_service.subchid;
+
+			fprintf(stderr, "DABlin: sending sub-channel %d (%s) via RTP to %s:%d\n", audio_service.subchid, audio_service.dab_plus ? "DAB+" : "DAB", address.c_str(), port);
+			service_player->SendRTP(rtp_sender, address, port);
+		}
+	}
+
+	// serve the primary component at the path of the SId (following it to another sub-channel)
+	if(!http_streamer || !service.IsPrimary())
+		return;
+
+	std::map<int, int>::iterator it = http_service_subchids.find(service.sid);
+	if(it != http_service_subchids.end() && it->second == audio_service.subchid)
+		return;
+
+	std::string path = "/" + StringTools::IntToHex(service.sid, 4).substr(2);
+	HTTPStream *http_stream = http_streamer->AddStream(path);
+	if(it != http_service_subchids.end())
+		service_players.at(it->second)->RemoveHTTPStream(http_stream);
+	else
+		fprintf(stderr, "DABlin: serving SId %s via HTTP at %s\n", StringTools::IntToHex(service.sid, 4).c_str(), path.c_str());
+	service_player->AddHTTPStream(http_stream);
+	http_service_subchids[service.sid] = audio_service.subchid;
+}
+
 void DABlinText::FICDiscardedFIB() {
 	fprintf(stderr, "\x1B[33m" "(FIB)" "\x1B[0m" " ");
 }
+
+
+// --- DABlinTextServicePlayer -----------------------------------------------------------------
+DABlinTextServicePlayer::DABlinTextServicePlayer(const std::string& source_format, const AUDIO_SERVICE& audio_service) {
+	// untouched stream only; paced by the main player
+	if(source_format == EnsembleSource::FORMAT_ETI)
+		ensemble_player = new ETIPlayer(AudioOutputType::UntouchedOnly, false, this);
+	else
+		ensemble_player = new EDIPlayer(AudioOutputType::UntouchedOnly, false, this);
+	ensemble_player->DisableFlowControl();
+
+	rtp_stream = nullptr;
+
+	SetAudioService(audio_service);
+}
+
+DABlinTextServicePlayer::~DABlinTextServicePlayer() {
+	// let the consumers know that the service has gone
+	ensemble_player->SetAudioService(AUDIO_SERVICE());
+	delete ensemble_player;
+	delete rtp_stream;
+}
+
+void DABlinTextServicePlayer::ProcessFrame(const uint8_t *data) {
+	// without RTP, the service is only decoded while HTTP clients are connected
+	bool needed = rtp_stream != nullptr;
+	for(HTTPStream* http_stream : http_streams)
+		needed |= http_stream->HasClients();
+
+	if(needed)
+		ensemble_player->ProcessFrame(data);
+}
+
+void DABlinTextServicePlayer::SetAudioService(const AUDIO_SERVICE& audio_service) {
+	if(!ensemble_player->IsSameAudioService(audio_service))
+		ensemble_player->SetAudioService(audio_service);
+}
+
+void DABlinTextServicePlayer::SendRTP(RTPSender *rtp_sender, const std::string& address, int port) {
+	rtp_stream = new RTPStream(rtp_sender, address, port);
+	ensemble_player->AddServiceUntouchedStreamConsumer(rtp_stream);
+}
+
+void DABlinTextServicePlayer::AddHTTPStream(HTTPStream *http_stream) {
+	http_streams.push_back(http_stream);
+	ensemble_player->AddServiceUntouchedStreamConsumer(http_stream);
+}
+
+void DABlinTextServicePlayer::RemoveHTTPStream(HTTPStream *http_stream) {
+	ensemble_player->RemoveServiceUntouchedStreamConsumer(http_stream);
+	for(auto it = http_streams.begin(); it != http_streams.end(); it++) {
+		if(*it == http_stream) {
+			http_streams.erase(it);
+			break;
+		}
+	}
+}
@@ -23,12 +23,15 @@
 #include "eti_player.h"
 
 #include <signal.h>
+#include <map>
 #include <string>
 
 #include "eti_source.h"
 #include "edi_source.h"
 #include "edi_player.h"
 #include "fic_decoder.h"
+#include "http_streamer.h"
+#include "rtp_sender.h"
 #include "tools.h"
 #include "version.h"
 
@@ -52,6 +55,14 @@ struct DABlinTextOptions {
 	bool disable_int_catch_up;
 	bool disable_dyn_fic_msgs;
 	int gain;
+	std::string ensemble_cache_dir;
+	size_t audio_latency_ms;
+	bool fixed_output_format;
+	size_t output_batch_size;
+	size_t output_flush_latency_ms;
+	string_vector_t extra_outputs;
+	std::string http_stream_bind;
+	std::string rtp_destination;
 DABlinTextOptions() :
 	source_format(EnsembleSource::FORMAT_ETI),
 	initial_first_found_service(false),
@@ -65,26 +76,58 @@ DABlinTextOptions() :
 	untouched_output(false),
 	disable_int_catch_up(false),
 	disable_dyn_fic_msgs(false),
-	gain(DAB_LIVE_SOURCE_CHANNEL::auto_gain)
+	gain(DAB_LIVE_SOURCE_CHANNEL::auto_gain),
+	audio_latency_ms(0),
+	fixed_output_format(false),
+	output_batch_size(0),
+	output_flush_latency_ms(BatchedWriter::default_flush_latency_ms)
 	{}
 };
 
 
+// --- DABlinTextServicePlayer -----------------------------------------------------------------
+// forwards the untouched stream of a single audio service via RTP and/or HTTP
+class DABlinTextServicePlayer : EnsemblePlayerObserver {
+private:
+	EnsemblePlayer *ensemble_player;
+	RTPStream *rtp_stream;
+	std::vector<HTTPStream*> http_streams;
+public:
+	DABlinTextServicePlayer(const std::string& source_format, const AUDIO_SERVICE& audio_service);
+	~DABlinTextServicePlayer();
+
+	void ProcessFrame(const uint8_t *data);
+	void SetAudioService(const AUDIO_SERVICE& audio_service);
+	void SendRTP(RTPSender *rtp_sender, const std::string& address, int port);
+	void AddHTTPStream(HTTPStream *http_stream);
+	void RemoveHTTPStream(HTTPStream *http_stream);
+};
+
+typedef std::map<int, DABlinTextServicePlayer*> service_players_t;	// by sub-channel
+
+
 // --- DABlinText -----------------------------------------------------------------
 class DABlinText : EnsembleSourceObserver, EnsemblePlayerObserver, FICDecoderObserver {
 private:
 	DABlinTextOptions options;
+	bool first_found_service_adopted;
 
 	EnsembleSource *ensemble_source;
 	EnsemblePlayer *ensemble_player;
 	FICDecoder *fic_decoder;
+	HTTPStreamer *http_streamer;
+	RTPSender *rtp_sender;
+	service_players_t service_players;
+	std::map<int, int> http_service_subchids;	// SId -> sub-channel currently served
 
-	void EnsembleProcessFrame(const uint8_t *data) {ensemble_player->ProcessFrame(data);}
+	void EnsembleProcessFrame(const uint8_t *data);
 	void EnsembleUpdateProgress(const ENSEMBLE_PROGRESS& progress);
 
 	void EnsembleProcessFIC(const uint8_t *data, size_t len) {fic_decoder->Process(data, len);}
 
 	void FICChangeService(const LISTED_SERVICE& service);
+	void FICResetEnsemble();
+	void UpdateServicePlayer(const LISTED_SERVICE& service);
 	void FICDiscardedFIB();
 public:
 	DABlinText(DABlinTextOptions options);
@@ -50,18 +50,26 @@ static void usage(const char* exe) {
 					"  -p           Output raw PCM to stdout instead of using SDL\n"
 					"  -w           Output RIFF WAVE with PCM to stdout instead of using SDL (useful only on Little Endian)\n"
 					"  -u           Output untouched audio stream to stdout instead of using SDL\n"
+					"  -b <ms>      Target latency of the SDL output in ms (default: 125)\n"
+					"  -O           Fix the SDL output to 48 kHz stereo (no device reopen on service switch)\n"
+					"  -B <bytes>   Batch output to stdout (pages written at once; vmsplice, if a pipe)\n"
+					"  -T <ms>      Max latency of batched output to stdout in ms (default: 100)\n"
+					"  -a <output>  Additional audio output: \"sdl\", \"pcm:<file>\", \"wav:<file>\" (can be used repeatedly)\n"
+					"  -H <port>    Serve untouched audio stream via HTTP on port (or <ip>:<port>; default IP: %s)\n"
 					"  -I           Don't catch up on stream after interruption\n"
 					"  -Y           Initially disable Dynamic Label Plus (DL+)\n"
 					"  -S           Initially disable slideshow\n"
 					"  -L           Enable loose behaviour (e.g. PAD conformance)\n"
 					"  -F           Disable dynamic FIC messages (dynamic PTY, announcements)\n"
+					"  -E <dir>     Use ensemble cache directory for instant start (requires DAB live source)\n"
 					"  file         Input file to be played (stdin, if not specified)\n",
 					EnsembleSource::FORMAT_ETI.c_str(),
 					EnsembleSource::FORMAT_EDI.c_str(),
 					DABLiveETISource::TYPE_DAB2ETI.c_str(),
 					DABLiveETISource::TYPE_ETI_CMDLINE.c_str(),
 					options_default.recordings_path.c_str(),
-					options_default.rec_prebuffer_size_s
+					options_default.rec_prebuffer_size_s,
+					HTTPStreamer::default_address.c_str()
 			);
 	exit(1);
 }
@@ -84,7 +92,7 @@ int main(int argc, char **argv) {
 
 	// option args
 	int c;
-	while((c = getopt(argc, argv, "hf:d:D:C:c:l:g:Gr:P:s:x:1pwuIYSLF")) != -1) {
+	while((c = getopt(argc, argv, "hf:d:D:C:c:l:g:Gr:P:s:x:1pwub:OB:T:a:H:IYSLFE:")) != -1) {
 		switch(c) {
 		case 'h':
 			usage(argv[0]);
@@ -142,6 +150,30 @@ int main(int argc, char **argv) {
 		case 'u':
 			options.untouched_output = true;
 			break;
+		case 'b':
+			options.audio_latency_ms = strtol(optarg, nullptr, 0);
+			if(options.audio_latency_ms == 0 || options.audio_latency_ms > 10000)
+				usage(argv[0]);
+			break;
+		case 'O':
+			options.fixed_output_format = true;
+			break;
+		case 'B':
+			options.output_batch_size = strtol(optarg, nullptr, 0);
+			if(options.output_batch_size == 0)
+				usage(argv[0]);
+			break;
+		case 'T':
+			options.output_flush_latency_ms = strtol(optarg, nullptr, 0);
+			if(options.output_flush_latency_ms == 0 || options.output_flush_latency_ms > 10000)
+				usage(argv[0]);
+			break;
+		case 'a':
+			options.extra_outputs.push_back(optarg);
+			break;
+		case 'H':
+			options.http_stream_bind = optarg;
+			break;
 		case 'I':
 			options.disable_int_catch_up = true;
 			break;
@@ -157,6 +189,9 @@ int main(int argc, char **argv) {
 		case 'F':
 			options.disable_dyn_fic_msgs = true;
 			break;
+		case 'E':
+			options.ensemble_cache_dir = optarg;
+			break;
 		case '?':
 		default:
 			usage(argv[0]);
@@ -184,6 +219,10 @@ int main(int argc, char **argv) {
 			fprintf(stderr, "If a channel is selected, DAB live source must be used!\n");
 			usage(argv[0]);
 		}
+		if(!options.ensemble_cache_dir.empty()) {
+			fprintf(stderr, "If an ensemble cache directory is selected, DAB live source must be used!\n");
+			usage(argv[0]);
+		}
 	} else {
 		if(options.source_format != EnsembleSource::FORMAT_ETI) {
 			fprintf(stderr, "A DAB live source can only be used with ETI source format!\n");
@@ -217,6 +256,30 @@ int main(int argc, char **argv) {
 		fprintf(stderr, "No more than one output option can be specified!\n");
 		usage(argv[0]);
 	}
+	for(const std::string& extra_output : options.extra_outputs) {
+		AudioOutputType audio_output_type;
+		std::string filename;
+		if(!EnsemblePlayer::ParseAudioOutput(extra_output, audio_output_type, filename)) {
+			fprintf(stderr, "The additional audio output '%s' is not supported!\n", extra_output.c_str());
+			usage(argv[0]);
+		}
+		if(options.untouched_output) {
+			fprintf(stderr, "Additional audio outputs cannot be used with untouched output!\n");
+			usage(argv[0]);
+		}
+		if(audio_output_type == AudioOutputType::SDL && !options.pcm_output && !options.wav_output) {
+			fprintf(stderr, "SDL output is already used as main output!\n");
+			usage(argv[0]);
+		}
+	}
+	if(!options.http_stream_bind.empty()) {
+		std::string address;
+		int port;
+		if(!HTTPStreamer::ParseBindAddress(options.http_stream_bind, address, port)) {
+			fprintf(stderr, "The HTTP stream address '%s' is not valid!\n", options.http_stream_bind.c_str());
+			usage(argv[0]);
+		}
+	}
 
 
 	// at most one param needed!
@@ -252,6 +315,7 @@ DABlinGTK::DABlinGTK(DABlinGTKOptions options) {
 	switch_service_sid = options.initial_sid;
 	switch_service_scids = options.initial_scids;
 	switch_service_applied = false;
+	first_found_service_adopted = false;
 
 	rec_file = nullptr;
 	rec_duration_ms = 0;
@@ -265,13 +329,14 @@ DABlinGTK::DABlinGTK(DABlinGTKOptions options) {
 	ensemble_update_progress.GetDispatcher().connect(sigc::mem_fun(*this, &DABlinGTK::EnsembleUpdateProgressEmitted));
 	ensemble_change_format.GetDispatcher().connect(sigc::mem_fun(*this, &DABlinGTK::EnsembleChangeFormatEmitted));
 	fic_change_ensemble.GetDispatcher().connect(sigc::mem_fun(*this, &DABlinGTK::FICChangeEnsembleEmitted));
-	fic_change_service.GetDispatcher().connect(sigc::mem_fun(*this, &DABlinGTK::FICChangeServiceEmitted));
+	fic_change_services.GetDispatcher().connect(sigc::mem_fun(*this, &DABlinGTK::FICChangeServicesEmitted));
 	pad_change_dynamic_label.GetDispatcher().connect(sigc::mem_fun(*this, &DABlinGTK::PADChangeDynamicLabelEmitted));
 	pad_change_slide.GetDispatcher().connect(sigc::mem_fun(*this, &DABlinGTK::PADChangeSlideEmitted));
 	pad_file_progress.GetDispatcher().connect(sigc::mem_fun(*this, &DABlinGTK::PADFileProgressEmitted));
 	do_rec_status_update.GetDispatcher().connect(sigc::mem_fun(*this, &DABlinGTK::DoRecStatusUpdateEmitted));
 	do_datetime_sync.GetDispatcher().connect(sigc::mem_fun(*this, &DABlinGTK::DoDateTimeSyncEmitted));
 	do_datetime_update.GetDispatcher().connect(sigc::mem_fun(*this, &DABlinGTK::DoDateTimeUpdateEmitted));
+	slideshow_window.signal_slide_shown().connect(sigc::mem_fun(*this, &DABlinGTK::on_slideshow_slide_shown));
 
 	AudioOutputType audio_output_type = AudioOutputType::SDL;
 #ifndef DABLIN_DISABLE_SDL
@@ -287,6 +352,27 @@ DABlinGTK::DABlinGTK(DABlinGTKOptions options) {
 		ensemble_player = new ETIPlayer(audio_output_type, options.disable_int_catch_up, this);
 	else
 		ensemble_player = new EDIPlayer(audio_output_type, options.disable_int_catch_up, this);
+	for(const std::string& extra_output : options.extra_outputs) {
+		AudioOutputType audio_output_type;
+		std::string filename;
+		EnsemblePlayer::ParseAudioOutput(extra_output, audio_output_type, filename);
+		ensemble_player->AddAudioOutput(audio_output_type, filename);
+	}
+	if(options.audio_latency_ms)
+		ensemble_player->SetAudioLatency(options.audio_latency_ms);
+	if(options.fixed_output_format)
+		ensemble_player->SetFixedOutputFormat(true);
+	if(options.output_batch_size)
+		ensemble_player->EnableBatchedOutput(options.output_batch_size, options.output_flush_latency_ms);
+
+	http_streamer = nullptr;
+	if(!options.http_stream_bind.empty()) {
+		std::string address;
+		int port;
+		HTTPStreamer::ParseBindAddress(options.http_stream_bind, address, port);
+		http_streamer = new HTTPStreamer(address, port);
+		ensemble_player->AddServiceUntouchedStreamConsumer(http_streamer->AddStream("/"));
+	}
 
 	if(options.source_format == EnsembleSource::FORMAT_ETI) {
 		if(!options.dab_live_source_binary.empty()) {
@@ -330,12 +416,23 @@ DABlinGTK::~DABlinGTK() {
 		delete ensemble_source;
 	}
 
+	SaveEnsembleCache();
+
 	delete ensemble_player;
+	delete http_streamer;
 
 	delete pad_decoder;
 	delete fic_decoder;
 }
 
+void DABlinGTK::SaveEnsembleCache() {
+	if(options.ensemble_cache_dir.empty() || ensemble_cache_channel.empty())
+		return;
+
+	fic_decoder->SaveCache(FICDecoder::GetCacheFilename(options.ensemble_cache_dir, ensemble_cache_channel));
+	ensemble_cache_channel = "";
+}
+
 int DABlinGTK::ComboChannelsSlotCompare(const Gtk::TreeModel::iterator& a, const Gtk::TreeModel::iterator& b) {
 	const DAB_LIVE_SOURCE_CHANNEL& ch_a = (DAB_LIVE_SOURCE_CHANNEL) (*a)[combo_channels_cols.col_channel];
 	const DAB_LIVE_SOURCE_CHANNEL& ch_b = (DAB_LIVE_SOURCE_CHANNEL) (*b)[combo_channels_cols.col_channel];
@@ -760,10 +857,11 @@ void DABlinGTK::on_tglbtn_record() {
 				rec_file = new_rec_file;
 				rec_filename = new_rec_filename;
 
-				// write prebuffer
+				// write prebuffer (at once)
+				std::vector<UNTOUCHED_STREAM_PART> prebuffer_parts;
 				for(const RecSample& s : rec_prebuffer)
-					if(fwrite(&s.data[0], s.data.size(), 1, rec_file) != 1)
-						perror("DABlinGTK: error while writing untouched stream prebuffer to file");
+					prebuffer_parts.push_back({s.data.data(), s.data.size()});
+				WriteRecParts(prebuffer_parts.data(), prebuffer_parts.size());
 				rec_duration_ms = rec_prebuffer_filled_ms;
 
 				// clear prebuffer
@@ -808,15 +906,19 @@ void DABlinGTK::on_tglbtn_record() {
 }
 
 void DABlinGTK::ProcessUntouchedStream(const uint8_t* data, size_t len, size_t duration_ms) {
+	UNTOUCHED_STREAM_PART part = {data, len};
+	ProcessUntouchedStreamParts(&part, 1, duration_ms);
+}
+
+void DABlinGTK::ProcessUntouchedStreamParts(const UNTOUCHED_STREAM_PART* parts, size_t count, size_t duration_ms) {
 	std::lock_guard<std::mutex> lock(rec_mutex);
 
 	// if recording in progress
 	if(rec_file) {
 		long int rec_duration_ms_old = rec_duration_ms;
 
-		// write sample
-		if(fwrite(data, len, 1, rec_file) != 1)
-			perror("DABlinGTK: error while writing untouched stream sample to file");
+		// write sample, without joining its parts before
+		WriteRecParts(parts, count);
 		rec_duration_ms += duration_ms;
 
 		// update status only on seconds change
@@ -828,7 +930,7 @@ void DABlinGTK::ProcessUntouchedStream(const uint8_t* data, size_t len, size_t d
 			long int rec_prebuffer_ms_old = rec_prebuffer_filled_ms;
 
 			// append sample
-			rec_prebuffer.emplace_back(data, len, duration_ms);
+			rec_prebuffer.emplace_back(parts, count, duration_ms);
 			rec_prebuffer_filled_ms += duration_ms;
 
 			// remove samples while needed
@@ -844,6 +946,36 @@ void DABlinGTK::ProcessUntouchedStream(const uint8_t* data, size_t len, size_t d
 	}
 }
 
+void DABlinGTK::WriteRecParts(const UNTOUCHED_STREAM_PART* parts, size_t count) {
+	// rec_mutex must already be locked!
+	// (the file is only written this way, so there is no stdio buffer to consider)
+	rec_iov.resize(count);
+	for(size_t i = 0; i < count; i++) {
+		rec_iov[i].iov_base = (void*) parts[i].data;
+		rec_iov[i].iov_len = parts[i].len;
+	}
+
+	size_t iov_index = 0;
+	while(iov_index < count) {
+		ssize_t written = writev(fileno(rec_file), &rec_iov[iov_index], std::min(count - iov_index, (size_t) IOV_MAX));
+		if(written == -1) {
+			if(errno == EINTR)
+				continue;
+			perror("DABlinGTK: error while writing untouched stream to file");
+			return;
+		}
+
+		// skip parts already written completely; adjust partially written part
+		size_t written_len = written;
+		while(iov_index < count && written_len >= rec_iov[iov_index].iov_len)
+			written_len -= rec_iov[iov_index++].iov_len;
+		if(iov_index < count) {
+			rec_iov[iov_index].iov_base = (uint8_t*) rec_iov[iov_index].iov_base + written_len;
+			rec_iov[iov_index].iov_len -= written_len;
+		}
+	}
+}
+
 void DABlinGTK::DoRecStatusUpdateEmitted() {
 	std::lock_guard<std::mutex> lock(rec_mutex);
 	UpdateRecStatus(do_rec_status_update.Pop());
@@ -897,6 +1029,12 @@ void DABlinGTK::on_tglbtn_slideshow() {
 		slideshow_window.hide();
 }
 
+void DABlinGTK::on_slideshow_slide_shown() {
+	// slides are decoded in the background, so show the window not until then
+	if(tglbtn_slideshow.get_active())
+		slideshow_window.TryToShow();
+}
+
 bool DABlinGTK::on_window_delete_event(GdkEventAny* /*any_event*/) {
 	// prevent exit while recording
 	if(tglbtn_record.get_active()) {
@@ -1117,10 +1255,31 @@ void DABlinGTK::FICChangeEnsembleEmitted() {
 	frame_label_ensemble.set_tooltip_text(tooltip_text);
 }
 
-void DABlinGTK::FICChangeServiceEmitted() {
-//	fprintf(stderr, "### FICChangeServiceEmitted\n");
+void DABlinGTK::FICChangeServicesEmitted() {
+//	fprintf(stderr, "### FICChangeServicesEmitted\n");
+
+	listed_services_t new_services = fic_change_services.Pop();
 
-	LISTED_SERVICE new_service = fic_change_service.Pop();
+	// no services at all: the cached ensemble was contradicted
+	if(new_services.empty()) {
+		combo_services_liststore->clear();	// also stops the audio service started from the cache
+
+		// the first found service must be found again
+		if(first_found_service_adopted) {
+			options.initial_first_found_service = true;
+			first_found_service_adopted = false;
+		}
+		return;
+	}
+
+	for(const LISTED_SERVICE& new_service : new_services)
+		ApplyListedService(new_service);
+}
+
+void DABlinGTK::ApplyListedService(const LISTED_SERVICE& new_service) {
+	// ignore services without label (yet)
+	if(new_service.label.IsNone())
+		return;
 
 	std::string label = FICDecoder::ConvertLabelToUTF8(new_service.label, nullptr);
 	std::string combo_label = label;
@@ -1150,6 +1309,7 @@ void DABlinGTK::FICChangeServiceEmitted() {
 			switch_service_sid = new_service.sid;
 			switch_service_scids = new_service.scids;
 			options.initial_first_found_service = false;
+			first_found_service_adopted = true;
 		}
 
 		// set (initial) service
@@ -1241,6 +1401,7 @@ void DABlinGTK::on_combo_channels() {
 		ensemble_source = nullptr;
 	}
 
+	SaveEnsembleCache();
 	EnsembleResetFIC();
 	combo_services_liststore->clear();	// TODO: prevent on_combo_services() being called for each deleted row
 	ensemble_player->StopAudio();
@@ -1275,6 +1436,12 @@ void DABlinGTK::on_combo_channels() {
 			switch_service_scids = LISTED_SERVICE::scids_none;
 		}
 
+		// speculatively start with cached ensemble, if available
+		if(!options.ensemble_cache_dir.empty()) {
+			ensemble_cache_channel = channel.block;
+			fic_decoder->LoadCache(FICDecoder::GetCacheFilename(options.ensemble_cache_dir, ensemble_cache_channel));
+		}
+
 		if(options.dab_live_source_type == DABLiveETISource::TYPE_ETI_CMDLINE)
 			ensemble_source = new EtiCmdlineETISource(options.dab_live_source_binary, channel, this);
 		else
@@ -1359,8 +1526,6 @@ void DABlinGTK::PADChangeSlideEmitted() {
 //	fprintf(stderr, "### PADChangeSlideEmitted\n");
 
 	slideshow_window.UpdateSlide(pad_change_slide.Pop());
-	if(tglbtn_slideshow.get_active())
-		slideshow_window.TryToShow();
 }
 
 void DABlinGTK::PADFileProgressEmitted() {
@@ -23,6 +23,8 @@
 #include "eti_player.h"
 
 #include <algorithm>
+#include <errno.h>
+#include <limits.h>
 #include <list>
 #include <mutex>
 #include <queue>
@@ -30,15 +32,19 @@
 #include <string>
 #include <thread>
 #include <time.h>
+#include <vector>
+#include <sys/uio.h>
 
 #include <gtkmm.h>
 
+#include "dablin_gtk_dispatcher.h"
 #include "dablin_gtk_dl_plus.h"
 #include "dablin_gtk_sls.h"
 #include "eti_source.h"
 #include "edi_source.h"
 #include "edi_player.h"
 #include "fic_decoder.h"
+#include "http_streamer.h"
 #include "pad_decoder.h"
 #include "tools.h"
 #include "version.h"
@@ -96,6 +102,13 @@ struct DABlinGTKOptions {
 	bool initially_disable_slideshow;
 	bool loose;
 	bool disable_dyn_fic_msgs;
+	std::string ensemble_cache_dir;
+	size_t audio_latency_ms;
+	bool fixed_output_format;
+	size_t output_batch_size;
+	size_t output_flush_latency_ms;
+	string_vector_t extra_outputs;
+	std::string http_stream_bind;
 	
 DABlinGTKOptions() :
 	source_format(EnsembleSource::FORMAT_ETI),
@@ -113,48 +126,25 @@ DABlinGTKOptions() :
 	initially_disable_dl_plus(false),
 	initially_disable_slideshow(false),
 	loose(false),
-	disable_dyn_fic_msgs(false)
+	disable_dyn_fic_msgs(false),
+	audio_latency_ms(0),
+	fixed_output_format(false),
+	output_batch_size(0),
+	output_flush_latency_ms(BatchedWriter::default_flush_latency_ms)
 	{}
 };
 
 
-// --- GTKDispatcherQueue -----------------------------------------------------------------
-template<typename T>
-class GTKDispatcherQueue {
-private:
-	Glib::Dispatcher dispatcher;
-	std::mutex mutex;
-	std::queue<T> values;
-public:
-	Glib::Dispatcher& GetDispatcher() {return dispatcher;}
-
-	void PushAndEmit(T value) {
-		{
-			std::lock_guard<std::mutex> lock(mutex);
-			values.push(value);
-		}
-		dispatcher.emit();
-	}
-
-	T Pop() {
-		std::lock_guard<std::mutex> lock(mutex);
-
-		T value = values.front();
-		values.pop();
-		return value;
-	}
-};
-
-
 // --- RecSample -----------------------------------------------------------------
 struct RecSample {
 	std::vector<uint8_t> data;
 	time_t ts;
 	size_t duration_ms;
 
-	RecSample(const uint8_t* data, size_t len, size_t duration_ms) {
-		this->data.resize(len);
-		memcpy(&this->data[0], data, len);
+	RecSample(const UNTOUCHED_STREAM_PART* parts, size_t count, size_t duration_ms) {
+		// join parts
+		for(size_t i = 0; i < count; i++)
+			data.insert(data.end(), parts[i].data, parts[i].data + parts[i].len);
 
 		ts = time(nullptr);
 		if(ts == (time_t) -1)
@@ -178,6 +168,7 @@ private:
 	int switch_service_sid;
 	int switch_service_scids;
 	bool switch_service_applied;
+	bool first_found_service_adopted;
 
 	DABlinGTKDLPlusWindow dl_plus_window;
 	DABlinGTKSlideshowWindow slideshow_window;
@@ -188,8 +179,12 @@ private:
 	EnsemblePlayer *ensemble_player;
 
 	FICDecoder *fic_decoder;
+	HTTPStreamer *http_streamer;
 	PADDecoder *pad_decoder;
 
+	std::string ensemble_cache_channel;		// channel of the current ensemble (to be cached)
+	void SaveEnsembleCache();
+
 	// recording
 	std::mutex rec_mutex;
 	FILE* rec_file;
@@ -197,6 +192,8 @@ private:
 	long int rec_duration_ms;
 	rec_samples_t rec_prebuffer;
 	long int rec_prebuffer_filled_ms;
+	std::vector<struct iovec> rec_iov;
+	void WriteRecParts(const UNTOUCHED_STREAM_PART* parts, size_t count);
 
 	// date/time
 	FIC_DAB_DT utc_dt_curr;
@@ -226,6 +223,7 @@ private:
 	void EnsembleProcessPAD(const uint8_t *xpad_data, size_t xpad_len, bool exact_xpad_len, const uint8_t* fpad_data) {pad_decoder->Process(xpad_data, xpad_len, exact_xpad_len, fpad_data);}
 
 	void ProcessUntouchedStream(const uint8_t* data, size_t len, size_t duration_ms);
+	void ProcessUntouchedStreamParts(const UNTOUCHED_STREAM_PART* parts, size_t count, size_t duration_ms);
 
 
 	Gtk::Grid top_grid;
@@ -285,6 +283,7 @@ private:
 	void on_vlmbtn(double value);
 	void on_tglbtn_dl_plus();
 	void on_tglbtn_slideshow();
+	void on_slideshow_slide_shown();
 	void on_combo_channels();
 	void on_combo_services();
 	bool on_window_delete_event(GdkEventAny* any_event);
@@ -312,9 +311,11 @@ private:
 	void FICChangeEnsemble(const FIC_ENSEMBLE& ensemble);
 	void FICChangeEnsembleEmitted();
 
-	GTKDispatcherQueue<LISTED_SERVICE> fic_change_service;
-	void FICChangeService(const LISTED_SERVICE& service) {fic_change_service.PushAndEmit(service);}
-	void FICChangeServiceEmitted();
+	GTKDispatcherQueue<listed_services_t> fic_change_services;
+	void FICChangeServices(const listed_services_t& services, unsigned int /*version*/) {fic_change_services.PushAndEmit(services);}
+	void FICResetEnsemble() {fic_change_services.PushAndEmit(listed_services_t());}	// via the same queue, to keep the order
+	void FICChangeServicesEmitted();
+	void ApplyListedService(const LISTED_SERVICE& new_service);
 
 	void FICChangeUTCDateTime(const FIC_DAB_DT& utc_dt);
 	void FICDiscardedFIB();
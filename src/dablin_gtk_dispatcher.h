@@ -0,0 +1,57 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DABLIN_GTK_DISPATCHER_H_
+#define DABLIN_GTK_DISPATCHER_H_
+
+#include <mutex>
+#include <queue>
+
+#include <gtkmm.h>
+
+
+
+// --- GTKDispatcherQueue -----------------------------------------------------------------
+template<typename T>
+class GTKDispatcherQueue {
+private:
+	Glib::Dispatcher dispatcher;
+	std::mutex mutex;
+	std::queue<T> values;
+public:
+	Glib::Dispatcher& GetDispatcher() {return dispatcher;}
+
+	void PushAndEmit(T value) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			values.push(std::move(value));
+		}
+		dispatcher.emit();
+	}
+
+	T Pop() {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		T value = std::move(values.front());
+		values.pop();
+		return value;
+	}
+};
+
+
+#endif /* DABLIN_GTK_DISPATCHER_H_ */
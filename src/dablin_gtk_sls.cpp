@@ -21,7 +21,15 @@
 
 
 // --- DABlinGTKSlideshowWindow -----------------------------------------------------------------
+const int DABlinGTKSlideshowWindow::max_slide_width = 640;		// twice the default slide size
+const int DABlinGTKSlideshowWindow::max_slide_height = 480;
+const size_t DABlinGTKSlideshowWindow::max_slides_decoded = 32;
+
 DABlinGTKSlideshowWindow::DABlinGTKSlideshowWindow() {
+	decode_exit = false;
+	decode_pending = false;
+	decode_request = 0;
+
 	pixbuf_waiting = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, false, 8, 320, 240);	// default slide size
 	pixbuf_waiting->fill(0x003000FF);
 
@@ -43,6 +51,18 @@ DABlinGTKSlideshowWindow::DABlinGTKSlideshowWindow() {
 	// add window key press event handler
 	signal_key_press_event().connect(sigc::mem_fun(*this, &DABlinGTKSlideshowWindow::HandleKeyPressEvent));
 	add_events(Gdk::KEY_PRESS_MASK);
+
+	decode_done.GetDispatcher().connect(sigc::mem_fun(*this, &DABlinGTKSlideshowWindow::DecodeDoneEmitted));
+	decode_thread = std::thread(&DABlinGTKSlideshowWindow::DecodeWorker, this);
+}
+
+DABlinGTKSlideshowWindow::~DABlinGTKSlideshowWindow() {
+	{
+		std::lock_guard<std::mutex> lock(decode_mutex);
+		decode_exit = true;
+	}
+	decode_cond.notify_one();
+	decode_thread.join();
 }
 
 void DABlinGTKSlideshowWindow::TryToShow() {
@@ -93,6 +113,8 @@ bool DABlinGTKSlideshowWindow::HandleKeyPressEvent(GdkEventKey* key_event) {
 }
 
 void DABlinGTKSlideshowWindow::AwaitSlide() {
+	decode_request++;	// discard slides still being decoded
+
 	set_title("Slideshow...");
 
 	image.set(pixbuf_waiting);
@@ -102,29 +124,138 @@ void DABlinGTKSlideshowWindow::AwaitSlide() {
 	progress_file.hide();
 }
 
+void DABlinGTKSlideshowWindow::ClearSlide() {
+	decode_request++;	// discard slides still being decoded
+
+	image.clear();
+}
+
 void DABlinGTKSlideshowWindow::UpdateSlide(const MOT_FILE& slide) {
-	std::string type_mime = "";
-	std::string type_display = "unknown";
+	uint64_t hash = HashSlide(slide);
+	decode_request++;
+
+	// show an already decoded slide (e.g. carousel repetition) right away
+	slides_decoded_t::const_iterator it = slides_decoded.find(hash);
+	if(it != slides_decoded.cend()) {
+		ShowSlide(slide, it->second);
+		return;
+	}
+
+	// otherwise decode it in the background (replacing any pending slide)
+	{
+		std::lock_guard<std::mutex> lock(decode_mutex);
+		decode_job.slide = slide;
+		decode_job.hash = hash;
+		decode_job.request = decode_request;
+		decode_pending = true;
+	}
+	decode_cond.notify_one();
+}
+
+void DABlinGTKSlideshowWindow::DecodeWorker() {
+	for(;;) {
+		SLIDE_DECODED slide_decoded;
+		{
+			std::unique_lock<std::mutex> lock(decode_mutex);
+			decode_cond.wait(lock, [&]{return decode_exit || decode_pending;});
+			if(decode_exit)
+				return;
+
+			slide_decoded = std::move(decode_job);
+			decode_pending = false;
+		}
+
+		DecodeSlide(slide_decoded);
+		decode_done.PushAndEmit(std::move(slide_decoded));
+	}
+}
 
+void DABlinGTKSlideshowWindow::DecodeSlide(SLIDE_DECODED& slide_decoded) {
+	const MOT_FILE& slide = slide_decoded.slide;
+
+	std::string type_mime = "";
 	switch(slide.content_sub_type) {
 	case MOT_FILE::CONTENT_SUB_TYPE_JFIF:
 		type_mime = "image/jpeg";
-		type_display = "JPEG";
 		break;
 	case MOT_FILE::CONTENT_SUB_TYPE_PNG:
 		type_mime = "image/png";
-		type_display = "PNG";
 		break;
 	}
 
-	Glib::RefPtr<Gdk::PixbufLoader> pixbuf_loader = Gdk::PixbufLoader::create(type_mime, true);
-	pixbuf_loader->write(&slide.data[0], slide.data.size());
-	pixbuf_loader->close();
+	Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+	try {
+		Glib::RefPtr<Gdk::PixbufLoader> pixbuf_loader = Gdk::PixbufLoader::create(type_mime, true);
+		pixbuf_loader->write(slide.data->data(), slide.data->size());
+		pixbuf_loader->close();
 
-	Glib::RefPtr<Gdk::Pixbuf> pixbuf = pixbuf_loader->get_pixbuf();
+		pixbuf = pixbuf_loader->get_pixbuf();
+	} catch(const Glib::Error& e) {
+		fprintf(stderr, "DABlinGTKSlideshowWindow: error while decoding slide: %s\n", e.what().c_str());
+		return;
+	}
 	if(!pixbuf)
 		return;
 
+	slide_decoded.width = pixbuf->get_width();
+	slide_decoded.height = pixbuf->get_height();
+
+	// prescale oversized slides (keeping the aspect ratio)
+	if(slide_decoded.width > max_slide_width || slide_decoded.height > max_slide_height) {
+		double scale = std::min((double) max_slide_width / slide_decoded.width, (double) max_slide_height / slide_decoded.height);
+		int width = std::max((int) (slide_decoded.width * scale), 1);
+		int height = std::max((int) (slide_decoded.height * scale), 1);
+		pixbuf = pixbuf->scale_simple(width, height, Gdk::INTERP_BILINEAR);
+	}
+
+	slide_decoded.pixbuf = pixbuf;
+}
+
+uint64_t DABlinGTKSlideshowWindow::HashSlide(const MOT_FILE& slide) {
+	// FNV-1a
+	uint64_t result = 0xCBF29CE484222325;
+	const uint8_t prefix[] = {(uint8_t) slide.content_type, (uint8_t) slide.content_sub_type};
+	for(const uint8_t& value : prefix)
+		result = (result ^ value) * 0x00000100000001B3;
+	for(const uint8_t& value : *slide.data)
+		result = (result ^ value) * 0x00000100000001B3;
+	return result;
+}
+
+void DABlinGTKSlideshowWindow::DecodeDoneEmitted() {
+	SLIDE_DECODED slide_decoded = decode_done.Pop();
+
+	// ignore undecodable slide
+	if(!slide_decoded.pixbuf)
+		return;
+
+	// show slide, if still desired
+	if(slide_decoded.request == decode_request)
+		ShowSlide(slide_decoded.slide, slide_decoded);
+
+	// add slide to cache (without the raw data), removing the oldest one if needed
+	if(slides_decoded.find(slide_decoded.hash) != slides_decoded.cend())
+		return;
+	if(slides_decoded.size() == max_slides_decoded) {
+		slides_decoded.erase(slides_decoded_order.front());
+		slides_decoded_order.pop_front();
+	}
+	slide_decoded.slide = MOT_FILE();
+	slides_decoded_order.push_back(slide_decoded.hash);
+	slides_decoded[slide_decoded.hash] = std::move(slide_decoded);
+}
+
+void DABlinGTKSlideshowWindow::ShowSlide(const MOT_FILE& slide, const SLIDE_DECODED& slide_decoded) {
+	std::string type_display = "unknown";
+	switch(slide.content_sub_type) {
+	case MOT_FILE::CONTENT_SUB_TYPE_JFIF:
+		type_display = "JPEG";
+		break;
+	case MOT_FILE::CONTENT_SUB_TYPE_PNG:
+		type_display = "PNG";
+		break;
+	}
+
 	// update title
 	std::string title = "Slideshow";
 	if(!slide.category_title.empty())
@@ -132,10 +263,10 @@ void DABlinGTKSlideshowWindow::UpdateSlide(const MOT_FILE& slide) {
 	set_title(title);
 
 	// update image
-	image.set(pixbuf);
+	image.set(slide_decoded.pixbuf);
 	image.set_tooltip_text(
-			"Resolution: " + std::to_string(pixbuf->get_width()) + "x" + std::to_string(pixbuf->get_height()) + " pixels\n"
-			"Size: " + std::to_string(slide.data.size()) + " bytes\n"
+			"Resolution: " + std::to_string(slide_decoded.width) + "x" + std::to_string(slide_decoded.height) + " pixels\n"
+			"Size: " + std::to_string(slide.data->size()) + " bytes\n"
 			"Format: " + type_display + "\n"
 			"Content name: \"" + slide.content_name + "\"\n"
 			"Content name charset: " + slide.content_name_charset);
@@ -158,6 +289,8 @@ void DABlinGTKSlideshowWindow::UpdateSlide(const MOT_FILE& slide) {
 
 	// hide file progress
 	progress_file.hide();
+
+	slide_shown.emit();
 }
 
 void DABlinGTKSlideshowWindow::UpdateFileProgress(const double fraction) {
@@ -19,14 +19,37 @@
 #ifndef DABLIN_GTK_SLS_H_
 #define DABLIN_GTK_SLS_H_
 
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include <gtkmm.h>
 
+#include "dablin_gtk_dispatcher.h"
 #include "mot_manager.h"
 
 
 
+// --- SLIDE_DECODED -----------------------------------------------------------------
+struct SLIDE_DECODED {
+	MOT_FILE slide;
+	uint64_t hash;
+	size_t request;
+
+	Glib::RefPtr<Gdk::Pixbuf> pixbuf;	// prescaled (if necessary)
+	int width;							// before prescaling
+	int height;
+
+	SLIDE_DECODED() : hash(0), request(0), width(0), height(0) {}
+};
+
+typedef std::map<uint64_t,SLIDE_DECODED> slides_decoded_t;	// content hash -> SLIDE_DECODED
+typedef std::list<uint64_t> slides_decoded_order_t;
+
+
 // --- DABlinGTKSlideshowWindow -----------------------------------------------------------------
 class DABlinGTKSlideshowWindow : public Gtk::Window {
 private:
@@ -39,9 +62,38 @@ private:
 	int prev_parent_x;
 	int prev_parent_y;
 
+	sigc::signal<void> slide_shown;
+
+	// decoding (worker thread)
+	std::thread decode_thread;
+	std::mutex decode_mutex;
+	std::condition_variable decode_cond;
+	bool decode_exit;
+	bool decode_pending;
+	SLIDE_DECODED decode_job;
+	size_t decode_request;
+	GTKDispatcherQueue<SLIDE_DECODED> decode_done;
+
+	// decoded slides (main thread)
+	slides_decoded_t slides_decoded;
+	slides_decoded_order_t slides_decoded_order;
+
+	static const int max_slide_width;
+	static const int max_slide_height;
+	static const size_t max_slides_decoded;
+
+	void DecodeWorker();
+	static void DecodeSlide(SLIDE_DECODED& slide_decoded);
+	static uint64_t HashSlide(const MOT_FILE& slide);
+	void DecodeDoneEmitted();
+	void ShowSlide(const MOT_FILE& slide, const SLIDE_DECODED& slide_decoded);
+
 	bool HandleKeyPressEvent(GdkEventKey* key_event);
 public:
 	DABlinGTKSlideshowWindow();
+	~DABlinGTKSlideshowWindow();
+
+	sigc::signal<void>& signal_slide_shown() {return slide_shown;}
 
 	void TryToShow();
 	void AlignToParent();
@@ -49,7 +101,7 @@ public:
 	void AwaitSlide();
 	void UpdateSlide(const MOT_FILE& slide);
 	void UpdateFileProgress(const double fraction);
-	void ClearSlide() {image.clear();}
+	void ClearSlide();
 	bool IsEmptySlide() {return image.get_storage_type() == Gtk::ImageType::IMAGE_EMPTY;}
 };
 
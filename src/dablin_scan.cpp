@@ -0,0 +1,600 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dablin_scan.h"
+
+static DABlinScan *dablin_scan = nullptr;
+
+static void break_handler(int) {
+	fprintf(stderr, "...DABlin scan exits...\n");
+	if(dablin_scan)
+		dablin_scan->DoExit();
+}
+
+
+static void usage(const char* exe) {
+	fprint_dablin_banner(stderr);
+	fprintf(stderr, "Usage: %s [OPTIONS] [file...]\n", exe);
+	fprintf(stderr, "  -h            Show this help\n"
+					"  -f <format>   Source format: \"%s\" (default), \"%s\"\n"
+					"  -d <binary>   Use DAB live source (using the mentioned binary)\n"
+					"  -D <type>     DAB live source type: \"%s\" (default), \"%s\"\n"
+					"  -C <ch>,...   Channels to be scanned (requires DAB live source)\n"
+					"  -g <gain>     USB stick gain to pass to DAB live source (auto gain is default)\n"
+					"  -G            Use default gain for DAB live source (instead of auto gain)\n"
+					"  -j <threads>  Number of inputs scanned in parallel (default: number of CPU cores; DAB live source: 1)\n"
+					"  -t <ms>       Maximum scan duration per input, in stream time (default: %zu)\n"
+					"  -o <format>   Catalog output format: \"%s\" (default), \"%s\"\n"
+					"  -m <file>     Monitor the audio of all services (until the maximum scan duration); write alarms to file\n"
+					"  file...       Input files to be scanned\n",
+					EnsembleSource::FORMAT_ETI.c_str(),
+					EnsembleSource::FORMAT_EDI.c_str(),
+					DABLiveETISource::TYPE_DAB2ETI.c_str(),
+					DABLiveETISource::TYPE_ETI_CMDLINE.c_str(),
+					DABlinScanOptions().max_scan_ms,
+					DABlinScanOptions::OUTPUT_FORMAT_JSON.c_str(),
+					DABlinScanOptions::OUTPUT_FORMAT_CSV.c_str()
+			);
+	exit(1);
+}
+
+
+int main(int argc, char **argv) {
+	// handle signals
+	if(signal(SIGINT, break_handler) == SIG_ERR) {
+		perror("DABlin: error while setting SIGINT handler");
+		return 1;
+	}
+	if(signal(SIGTERM, break_handler) == SIG_ERR) {
+		perror("DABlin: error while setting SIGTERM handler");
+		return 1;
+	}
+
+	DABlinScanOptions options;
+	int gain_param_count = 0;
+
+	// option args
+	int c;
+	while((c = getopt(argc, argv, "hf:d:D:C:g:Gj:t:o:m:")) != -1) {
+		switch(c) {
+		case 'h':
+			usage(argv[0]);
+			break;
+		case 'f':
+			options.source_format = optarg;
+			break;
+		case 'd':
+			options.dab_live_source_binary = optarg;
+			break;
+		case 'D':
+			options.dab_live_source_type = optarg;
+			break;
+		case 'C':
+			options.channels = StringTools::SplitString(optarg, ',');
+			break;
+		case 'g':
+			options.gain = strtol(optarg, nullptr, 0);
+			gain_param_count++;
+			break;
+		case 'G':
+			options.gain = DAB_LIVE_SOURCE_CHANNEL::default_gain;
+			gain_param_count++;
+			break;
+		case 'j':
+			options.threads = strtol(optarg, nullptr, 0);
+			break;
+		case 't':
+			options.max_scan_ms = strtol(optarg, nullptr, 0);
+			break;
+		case 'o':
+			options.output_format = optarg;
+			break;
+		case 'm':
+			options.events_filename = optarg;
+			break;
+		case '?':
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	// non-option args
+	for(int i = optind; i < argc; i++)
+		options.filenames.push_back(argv[i]);
+
+	// ensure valid options
+	if(options.dab_live_source_binary.empty()) {
+		if(!options.channels.empty()) {
+			fprintf(stderr, "If channels are selected, DAB live source must be used!\n");
+			usage(argv[0]);
+		}
+		if(options.filenames.empty()) {
+			fprintf(stderr, "At least one file must be specified!\n");
+			usage(argv[0]);
+		}
+	} else {
+		if(options.source_format != EnsembleSource::FORMAT_ETI) {
+			fprintf(stderr, "A DAB live source can only be used with ETI source format!\n");
+			usage(argv[0]);
+		}
+		if(!options.filenames.empty()) {
+			fprintf(stderr, "Both files and DAB live source cannot be used as source!\n");
+			usage(argv[0]);
+		}
+		if(options.channels.empty()) {
+			fprintf(stderr, "If DAB live source is used, at least one channel must be selected!\n");
+			usage(argv[0]);
+		}
+		for(const std::string& channel : options.channels) {
+			if(dab_channels.find(channel) == dab_channels.end()) {
+				fprintf(stderr, "The channel '%s' is not supported!\n", channel.c_str());
+				usage(argv[0]);
+			}
+		}
+		if(options.dab_live_source_type != DABLiveETISource::TYPE_DAB2ETI && options.dab_live_source_type != DABLiveETISource::TYPE_ETI_CMDLINE) {
+			fprintf(stderr, "The DAB live source type '%s' is not supported!\n", options.dab_live_source_type.c_str());
+			usage(argv[0]);
+		}
+	}
+	if(options.source_format != EnsembleSource::FORMAT_ETI && options.source_format != EnsembleSource::FORMAT_EDI) {
+		fprintf(stderr, "The source format '%s' is not supported!\n", options.source_format.c_str());
+		usage(argv[0]);
+	}
+	if(options.output_format != DABlinScanOptions::OUTPUT_FORMAT_JSON && options.output_format != DABlinScanOptions::OUTPUT_FORMAT_CSV) {
+		fprintf(stderr, "The output format '%s' is not supported!\n", options.output_format.c_str());
+		usage(argv[0]);
+	}
+	if(options.max_scan_ms == 0) {
+		fprintf(stderr, "The maximum scan duration must be greater than zero!\n");
+		usage(argv[0]);
+	}
+
+	// at most one param needed!
+	if(gain_param_count > 1) {
+		fprintf(stderr, "At most one gain parameter shall be specified!\n");
+		usage(argv[0]);
+	}
+
+
+	fprint_dablin_banner(stderr);
+
+	dablin_scan = new DABlinScan(options);
+	int result = dablin_scan->Main();
+	delete dablin_scan;
+
+	return result;
+}
+
+
+
+// --- DABlinScanOptions -----------------------------------------------------------------
+const std::string DABlinScanOptions::OUTPUT_FORMAT_JSON = "json";
+const std::string DABlinScanOptions::OUTPUT_FORMAT_CSV = "csv";
+
+
+// --- DABlinScanEvents -----------------------------------------------------------------
+DABlinScanEvents::DABlinScanEvents(const std::string& filename) {
+	events_file = fopen(filename.c_str(), "w");
+	if(!events_file)
+		throw std::runtime_error("DABlinScanEvents: error while opening events file '" + filename + "': " + std::string(strerror(errno)));
+}
+
+DABlinScanEvents::~DABlinScanEvents() {
+	fclose(events_file);
+}
+
+void DABlinScanEvents::Write(const std::string& line) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	fprintf(events_file, "%s\n", line.c_str());
+	fflush(events_file);
+}
+
+
+// --- DABlinScanServiceMonitor -----------------------------------------------------------------
+DABlinScanServiceMonitor::DABlinScanServiceMonitor(DABlinScanJob *job, const std::string& source_format, const LISTED_SERVICE& service) : audio_monitor(this) {
+	this->job = job;
+
+	// decoded audio only
+	if(source_format == EnsembleSource::FORMAT_ETI)
+		ensemble_player = new ETIPlayer(AudioOutputType::None, false, this);
+	else
+		ensemble_player = new EDIPlayer(AudioOutputType::None, false, this);
+	ensemble_player->DisableFlowControl();
+
+	SetService(service);
+}
+
+DABlinScanServiceMonitor::~DABlinScanServiceMonitor() {
+	delete ensemble_player;
+}
+
+void DABlinScanServiceMonitor::SetService(const LISTED_SERVICE& service) {
+	this->service = service;
+	ensemble_player->SetAudioService(service.audio_service);
+}
+
+void DABlinScanServiceMonitor::AudioMonitorEvent(const AUDIO_MONITOR_EVENT& event) {
+	job->WriteAudioEvent(service, event);
+}
+
+
+// --- DABlinScanJob -----------------------------------------------------------------
+DABlinScanJob::DABlinScanJob(const DABlinScanOptions& options, const std::string& input, bool live_source, DABlinScanEvents *events) {
+	this->options = options;
+	this->input = input;
+	this->live_source = live_source;
+	this->events = events;
+
+	ensemble_source = nullptr;
+	do_exit = false;
+
+	max_scan_ms = options.max_scan_ms;
+	frames_count = 0;
+
+	// FIC only i.e. no audio output at all
+	if(options.source_format == EnsembleSource::FORMAT_ETI)
+		ensemble_player = new ETIPlayer(AudioOutputType::None, false, this);
+	else
+		ensemble_player = new EDIPlayer(AudioOutputType::None, false, this);
+	ensemble_player->DisableFlowControl();
+
+	fic_decoder = new FICDecoder(this, true);
+}
+
+DABlinScanJob::~DABlinScanJob() {
+	delete ensemble_player;
+	delete fic_decoder;
+
+	for(auto& service_monitor : service_monitors)
+		delete service_monitor.second;
+}
+
+void DABlinScanJob::DoExit() {
+	std::lock_guard<std::mutex> lock(source_mutex);
+
+	do_exit = true;
+	if(ensemble_source)
+		ensemble_source->DoExit();
+}
+
+int DABlinScanJob::Main() {
+	{
+		std::lock_guard<std::mutex> lock(source_mutex);
+
+		if(do_exit)
+			return 1;
+
+		if(options.source_format == EnsembleSource::FORMAT_ETI) {
+			if(!live_source) {
+				ensemble_source = new ETISource(input, this);
+			} else {
+				DAB_LIVE_SOURCE_CHANNEL channel(input, dab_channels.at(input), options.gain);
+
+				if(options.dab_live_source_type == DABLiveETISource::TYPE_ETI_CMDLINE)
+					ensemble_source = new EtiCmdlineETISource(options.dab_live_source_binary, channel, this);
+				else
+					ensemble_source = new DAB2ETIETISource(options.dab_live_source_binary, channel, this);
+			}
+		} else {
+			ensemble_source = new EDISource(input, this);
+		}
+	}
+
+	int result = ensemble_source->Main();
+
+	// release the source (e.g. the tuner of a DAB live source) before the next job starts
+	{
+		std::lock_guard<std::mutex> lock(source_mutex);
+
+		delete ensemble_source;
+		ensemble_source = nullptr;
+	}
+
+	completeness = fic_decoder->GetCompleteness();
+
+	fprintf(stderr, "DABlinScanJob: '%s': FIC %s after %zu ms (%zu services, carousel %zu ms)\n",
+			input.c_str(), IsComplete() ? "complete" : "incomplete", GetScanMs(), services.size(), GetCarouselMs());
+	return result;
+}
+
+void DABlinScanJob::EnsembleProcessFrame(const uint8_t *data) {
+	frames_count++;
+	ensemble_player->ProcessFrame(data);
+
+	// (the FIC may have added further services)
+	for(auto& service_monitor : service_monitors)
+		service_monitor.second->ProcessFrame(data);
+
+	CheckScanDone();
+}
+
+void DABlinScanJob::CheckScanDone() {
+	// stop early, as soon as the FIC is complete (unless monitoring)
+	if((IsComplete() && !IsMonitoring()) || GetScanMs() >= max_scan_ms)
+		ensemble_source->DoExit();
+}
+
+void DABlinScanJob::FICChangeEnsemble(const FIC_ENSEMBLE& ensemble) {
+	this->ensemble = ensemble;
+}
+
+void DABlinScanJob::FICChangeService(const LISTED_SERVICE& service) {
+	std::pair<int,int> key = std::make_pair(service.sid, service.scids);
+	services[key] = service;
+
+	// monitor each audio service, as soon as its sub-channel is known
+	if(!IsMonitoring() || service.audio_service.IsNone())
+		return;
+	service_monitors_t::iterator it = service_monitors.find(key);
+	if(it == service_monitors.end())
+		service_monitors[key] = new DABlinScanServiceMonitor(this, options.source_format, service);
+	else
+		it->second->SetService(service);
+}
+
+bool DABlinScanJob::GetAudioStats(const LISTED_SERVICE& service, AUDIO_MONITOR_STATS& stats) const {
+	service_monitors_t::const_iterator it = service_monitors.find(std::make_pair(service.sid, service.scids));
+	if(it == service_monitors.end())
+		return false;
+	stats = it->second->GetStats();
+	return true;
+}
+
+void DABlinScanJob::WriteAudioEvent(const LISTED_SERVICE& service, const AUDIO_MONITOR_EVENT& event) {
+	std::string line = "{";
+	line += "\"input\": " + DABlinScan::EscapeJSON(input) + ", ";
+	line += "\"stream_ms\": " + std::to_string(GetScanMs()) + ", ";
+	line += "\"sid\": " + DABlinScan::EscapeJSON(StringTools::IntToHex(service.sid, 4)) + ", ";
+	line += "\"scids\": " + (service.IsPrimary() ? "null" : std::to_string(service.scids)) + ", ";
+	line += "\"label\": " + (service.label.IsNone() ? "null" : DABlinScan::EscapeJSON(FICDecoder::ConvertLabelToUTF8(service.label, nullptr))) + ", ";
+	line += "\"event\": \"" + std::string(event.GetTypeName()) + "\", ";
+	line += "\"start_ms\": " + std::to_string(event.start_ms);
+	if(event.type == AUDIO_MONITOR_EVENT::Type::SilenceEnd || event.type == AUDIO_MONITOR_EVENT::Type::ClippingEnd)
+		line += ", \"duration_ms\": " + std::to_string(event.duration_ms);
+	if(event.type == AUDIO_MONITOR_EVENT::Type::ClippingEnd)
+		line += ", \"clipped_samples\": " + std::to_string(event.clipped_samples);
+	line += "}";
+
+	fprintf(stderr, "DABlinScanJob: '%s': service 0x%04X: %s\n", input.c_str(), service.sid, event.GetTypeName());
+	events->Write(line);
+}
+
+listed_services_t DABlinScanJob::GetServices() const {
+	listed_services_t result;
+	for(const auto& service : services)
+		result.push_back(service.second);
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+
+// --- DABlinScan -----------------------------------------------------------------
+const size_t DABlinScan::exit_check_interval_ms = 100;
+
+DABlinScan::DABlinScan(DABlinScanOptions options) {
+	this->options = options;
+
+	next_job = 0;
+	running_workers = 0;
+	do_exit = false;
+
+	events = options.events_filename.empty() ? nullptr : new DABlinScanEvents(options.events_filename);
+
+	if(options.dab_live_source_binary.empty()) {
+		for(const std::string& filename : options.filenames)
+			jobs.push_back(new DABlinScanJob(options, filename, false, events));
+	} else {
+		for(const std::string& channel : options.channels)
+			jobs.push_back(new DABlinScanJob(options, channel, true, events));
+	}
+}
+
+DABlinScan::~DABlinScan() {
+	for(DABlinScanJob* job : jobs)
+		delete job;
+	delete events;
+}
+
+void DABlinScan::Worker() {
+	while(!do_exit) {
+		size_t index = next_job++;
+		if(index >= jobs.size())
+			break;
+		jobs[index]->Main();
+	}
+	running_workers--;
+}
+
+int DABlinScan::Main() {
+	// a DAB live source usually uses a single tuner, so scan channels one by one by default
+	size_t threads = options.threads;
+	if(threads == 0)
+		threads = options.dab_live_source_binary.empty() ? std::max(std::thread::hardware_concurrency(), 1U) : 1;
+	threads = std::min(threads, jobs.size());
+
+	fprintf(stderr, "DABlinScan: scanning %zu input(s) using %zu thread(s)\n", jobs.size(), threads);
+
+	std::vector<std::thread> workers;
+	running_workers = threads;
+	for(size_t i = 0; i < threads; i++)
+		workers.emplace_back(&DABlinScan::Worker, this);
+
+	// the signal handler only sets the flag, as stopping the jobs needs locking
+	bool jobs_stopped = false;
+	while(running_workers) {
+		if(do_exit && !jobs_stopped) {
+			for(DABlinScanJob* job : jobs)
+				job->DoExit();
+			jobs_stopped = true;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(exit_check_interval_ms));
+	}
+	for(std::thread& worker : workers)
+		worker.join();
+
+	// output (also partial) catalog
+	if(options.output_format == DABlinScanOptions::OUTPUT_FORMAT_CSV)
+		WriteCatalogCSV(stdout);
+	else
+		WriteCatalogJSON(stdout);
+	fflush(stdout);
+
+	return do_exit ? 1 : 0;
+}
+
+std::string DABlinScan::EscapeJSON(const std::string& value) {
+	std::string result = "\"";
+	for(const char& c : value) {
+		switch(c) {
+		case '"':
+			result += "\\\"";
+			break;
+		case '\\':
+			result += "\\\\";
+			break;
+		default:
+			if((unsigned char) c < 0x20) {
+				char escape[7];
+				snprintf(escape, sizeof(escape), "\\u%04X", (unsigned char) c);
+				result += escape;
+			} else {
+				result += c;
+			}
+		}
+	}
+	return result + "\"";
+}
+
+std::string DABlinScan::FormatLevel(double value, const std::string& none) {
+	if(std::isinf(value))
+		return none;
+
+	char result[16];
+	snprintf(result, sizeof(result), "%.1f", value);
+	return result;
+}
+
+std::string DABlinScan::EscapeCSV(const std::string& value) {
+	if(value.find_first_of(",\"\r\n") == std::string::npos)
+		return value;
+
+	std::string result = "\"";
+	for(const char& c : value) {
+		if(c == '"')
+			result += '"';
+		result += c;
+	}
+	return result + "\"";
+}
+
+void DABlinScan::WriteCatalogJSON(FILE *out_file) {
+	fprintf(out_file, "[");
+	for(size_t i = 0; i < jobs.size(); i++) {
+		const DABlinScanJob* job = jobs[i];
+		const FIC_ENSEMBLE& ensemble = job->GetEnsemble();
+
+		fprintf(out_file, "%s\n\t{\n", i ? "," : "");
+		fprintf(out_file, "\t\t\"input\": %s,\n", EscapeJSON(job->GetInput()).c_str());
+		fprintf(out_file, "\t\t\"complete\": %s,\n", job->IsComplete() ? "true" : "false");
+		fprintf(out_file, "\t\t\"scan_ms\": %zu,\n", job->GetScanMs());
+		fprintf(out_file, "\t\t\"carousel_ms\": %zu,\n", job->GetCarouselMs());
+		fprintf(out_file, "\t\t\"eid\": %s,\n", ensemble.IsNone() ? "null" : EscapeJSON(StringTools::IntToHex(ensemble.eid, 4)).c_str());
+		fprintf(out_file, "\t\t\"label\": %s,\n", ensemble.label.IsNone() ? "null" : EscapeJSON(FICDecoder::ConvertLabelToUTF8(ensemble.label, nullptr)).c_str());
+		fprintf(out_file, "\t\t\"services\": [");
+
+		listed_services_t services = job->GetServices();
+		for(size_t j = 0; j < services.size(); j++) {
+			const LISTED_SERVICE& service = services[j];
+
+			fprintf(out_file, "%s\n\t\t\t{", j ? "," : "");
+			fprintf(out_file, "\"sid\": %s, ", EscapeJSON(StringTools::IntToHex(service.sid, 4)).c_str());
+			if(service.IsPrimary())
+				fprintf(out_file, "\"scids\": null, ");
+			else
+				fprintf(out_file, "\"scids\": %d, ", service.scids);
+			fprintf(out_file, "\"label\": %s, ", service.label.IsNone() ? "null" : EscapeJSON(FICDecoder::ConvertLabelToUTF8(service.label, nullptr)).c_str());
+			fprintf(out_file, "\"subchid\": %d, ", service.audio_service.subchid);
+			if(service.subchannel.bitrate == -1)
+				fprintf(out_file, "\"bitrate\": null, ");
+			else
+				fprintf(out_file, "\"bitrate\": %d, ", service.subchannel.bitrate);
+			fprintf(out_file, "\"codec\": \"%s\", ", service.audio_service.dab_plus ? "AAC" : "MP2");
+			fprintf(out_file, "\"sls\": %s", service.HasSLS() ? "true" : "false");
+
+			AUDIO_MONITOR_STATS stats;
+			if(job->GetAudioStats(service, stats)) {
+				fprintf(out_file, ", \"audio\": {");
+				fprintf(out_file, "\"audio_ms\": %zu, ", stats.audio_ms);
+				fprintf(out_file, "\"peak_dbfs\": %s, ", FormatLevel(stats.peak_dbfs, "null").c_str());
+				fprintf(out_file, "\"clipped_samples\": %zu, ", stats.clipped_samples);
+				fprintf(out_file, "\"silence_ms\": %zu, ", stats.silence_ms);
+				fprintf(out_file, "\"max_momentary_lufs\": %s, ", FormatLevel(stats.max_momentary_lufs, "null").c_str());
+				fprintf(out_file, "\"integrated_lufs\": %s}", FormatLevel(stats.integrated_lufs, "null").c_str());
+			} else if(job->IsMonitoring()) {
+				fprintf(out_file, ", \"audio\": null");
+			}
+			fprintf(out_file, "}");
+		}
+
+		fprintf(out_file, "%s]\n\t}", services.empty() ? "" : "\n\t\t");
+	}
+	fprintf(out_file, "%s]\n", jobs.empty() ? "" : "\n");
+}
+
+void DABlinScan::WriteCatalogCSV(FILE *out_file) {
+	bool monitoring = !options.events_filename.empty();
+	fprintf(out_file, "input,complete,carousel_ms,eid,ensemble_label,sid,scids,label,subchid,bitrate,codec,sls%s\n",
+			monitoring ? ",audio_ms,peak_dbfs,clipped_samples,silence_ms,max_momentary_lufs,integrated_lufs" : "");
+	for(const DABlinScanJob* job : jobs) {
+		const FIC_ENSEMBLE& ensemble = job->GetEnsemble();
+		std::string ensemble_columns =
+				EscapeCSV(job->GetInput()) + "," +
+				(job->IsComplete() ? "1" : "0") + "," +
+				std::to_string(job->GetCarouselMs()) + "," +
+				(ensemble.IsNone() ? "" : StringTools::IntToHex(ensemble.eid, 4)) + "," +
+				(ensemble.label.IsNone() ? "" : EscapeCSV(FICDecoder::ConvertLabelToUTF8(ensemble.label, nullptr)));
+
+		for(const LISTED_SERVICE& service : job->GetServices()) {
+			std::string audio_columns;
+			AUDIO_MONITOR_STATS stats;
+			if(job->GetAudioStats(service, stats)) {
+				audio_columns =
+						"," + std::to_string(stats.audio_ms) +
+						"," + FormatLevel(stats.peak_dbfs, "") +
+						"," + std::to_string(stats.clipped_samples) +
+						"," + std::to_string(stats.silence_ms) +
+						"," + FormatLevel(stats.max_momentary_lufs, "") +
+						"," + FormatLevel(stats.integrated_lufs, "");
+			} else if(monitoring) {
+				audio_columns = ",,,,,,";
+			}
+
+			fprintf(out_file, "%s,%s,%s,%s,%d,%s,%s,%d%s\n",
+					ensemble_columns.c_str(),
+					StringTools::IntToHex(service.sid, 4).c_str(),
+					service.IsPrimary() ? "" : std::to_string(service.scids).c_str(),
+					service.label.IsNone() ? "" : EscapeCSV(FICDecoder::ConvertLabelToUTF8(service.label, nullptr)).c_str(),
+					service.audio_service.subchid,
+					service.subchannel.bitrate == -1 ? "" : std::to_string(service.subchannel.bitrate).c_str(),
+					service.audio_service.dab_plus ? "AAC" : "MP2",
+					service.HasSLS() ? 1 : 0,
+					audio_columns.c_str());
+		}
+	}
+}
@@ -0,0 +1,199 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DABLIN_SCAN_H_
+#define DABLIN_SCAN_H_
+
+// eti_player.h, that indirectly includes SDL.h, must be included before <string> or it won't compile on OS X
+#include "eti_player.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <errno.h>
+#include <map>
+#include <mutex>
+#include <signal.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "eti_source.h"
+#include "edi_source.h"
+#include "edi_player.h"
+#include "audio_monitor.h"
+#include "fic_decoder.h"
+#include "tools.h"
+#include "version.h"
+
+
+// --- DABlinScanOptions -----------------------------------------------------------------
+struct DABlinScanOptions {
+	string_vector_t filenames;
+	std::string source_format;
+	std::string dab_live_source_binary;
+	std::string dab_live_source_type;
+	string_vector_t channels;
+	int gain;
+	size_t threads;
+	size_t max_scan_ms;
+	std::string output_format;
+	std::string events_filename;	// monitoring, if set
+DABlinScanOptions() :
+	source_format(EnsembleSource::FORMAT_ETI),
+	dab_live_source_type(DABLiveETISource::TYPE_DAB2ETI),
+	gain(DAB_LIVE_SOURCE_CHANNEL::auto_gain),
+	threads(0),
+	max_scan_ms(10000),
+	output_format(OUTPUT_FORMAT_JSON)
+	{}
+
+	static const std::string OUTPUT_FORMAT_JSON;
+	static const std::string OUTPUT_FORMAT_CSV;
+};
+
+
+// --- DABlinScanEvents -----------------------------------------------------------------
+// writes events (JSON lines) of all jobs to a file
+class DABlinScanEvents {
+private:
+	FILE *events_file;
+	std::mutex mutex;
+public:
+	DABlinScanEvents(const std::string& filename);
+	~DABlinScanEvents();
+
+	void Write(const std::string& line);
+};
+
+
+class DABlinScanJob;
+
+// --- DABlinScanServiceMonitor -----------------------------------------------------------------
+// decodes a single audio service of the ensemble and monitors its audio
+class DABlinScanServiceMonitor : EnsemblePlayerObserver, AudioMonitorObserver {
+private:
+	DABlinScanJob *job;
+	LISTED_SERVICE service;
+
+	EnsemblePlayer *ensemble_player;
+	AudioMonitor audio_monitor;
+
+	void EnsembleStartAudio(int samplerate, int channels) {audio_monitor.SetFormat(samplerate, channels);}
+	void EnsemblePutAudio(const uint8_t *data, size_t len) {audio_monitor.Process((const int16_t*) data, len / sizeof(int16_t));}
+
+	void AudioMonitorEvent(const AUDIO_MONITOR_EVENT& event);
+public:
+	DABlinScanServiceMonitor(DABlinScanJob *job, const std::string& source_format, const LISTED_SERVICE& service);
+	~DABlinScanServiceMonitor();
+
+	void ProcessFrame(const uint8_t *data) {ensemble_player->ProcessFrame(data);}
+	void SetService(const LISTED_SERVICE& service);
+	AUDIO_MONITOR_STATS GetStats() const {return audio_monitor.GetStats();}
+};
+
+typedef std::map<std::pair<int,int>, DABlinScanServiceMonitor*> service_monitors_t;
+
+
+// --- DABlinScanJob -----------------------------------------------------------------
+class DABlinScanJob : EnsembleSourceObserver, EnsemblePlayerObserver, FICDecoderObserver {
+private:
+	DABlinScanOptions options;
+	std::string input;
+	bool live_source;
+
+	// the source (and a DAB live source process) only exists while the job runs
+	std::mutex source_mutex;
+	EnsembleSource *ensemble_source;
+	bool do_exit;
+	EnsemblePlayer *ensemble_player;
+	FICDecoder *fic_decoder;
+
+	size_t max_scan_ms;
+	size_t frames_count;
+	FIC_COMPLETENESS completeness;
+
+	FIC_ENSEMBLE ensemble;
+	emitted_listed_services_t services;
+
+	DABlinScanEvents *events;	// monitoring, if set
+	service_monitors_t service_monitors;
+
+	void CheckScanDone();
+
+	void EnsembleProcessFrame(const uint8_t *data);
+	void EnsembleProcessFIC(const uint8_t *data, size_t len) {fic_decoder->Process(data, len);}
+
+	void FICChangeEnsemble(const FIC_ENSEMBLE& ensemble);
+	void FICChangeService(const LISTED_SERVICE& service);
+	void FICChangeCompleteness(const FIC_COMPLETENESS& completeness) {this->completeness = completeness;}
+public:
+	DABlinScanJob(const DABlinScanOptions& options, const std::string& input, bool live_source, DABlinScanEvents *events);
+	~DABlinScanJob();
+
+	int Main();
+	void DoExit();
+
+	const std::string& GetInput() const {return input;}
+	bool IsComplete() const {return completeness.complete;}
+	size_t GetCarouselMs() const {return completeness.carousel_ms;}
+	size_t GetScanMs() const {return frames_count * 24;}
+	const FIC_ENSEMBLE& GetEnsemble() const {return ensemble;}
+	listed_services_t GetServices() const;
+	bool IsMonitoring() const {return events;}
+	bool GetAudioStats(const LISTED_SERVICE& service, AUDIO_MONITOR_STATS& stats) const;
+
+	void WriteAudioEvent(const LISTED_SERVICE& service, const AUDIO_MONITOR_EVENT& event);
+};
+
+typedef std::vector<DABlinScanJob*> scan_jobs_t;
+
+
+// --- DABlinScan -----------------------------------------------------------------
+class DABlinScan {
+private:
+	DABlinScanOptions options;
+
+	DABlinScanEvents *events;
+	scan_jobs_t jobs;
+	std::atomic<size_t> next_job;
+	std::atomic<size_t> running_workers;
+	std::atomic<bool> do_exit;	// lock-free, as set by the signal handler
+	static const size_t exit_check_interval_ms;
+
+	void Worker();
+
+	void WriteCatalogJSON(FILE *out_file);
+	void WriteCatalogCSV(FILE *out_file);
+
+	static std::string EscapeCSV(const std::string& value);
+	static std::string FormatLevel(double value, const std::string& none);
+public:
+	DABlinScan(DABlinScanOptions options);
+	~DABlinScan();
+
+	void DoExit() {do_exit = true;}	// async-signal-safe; the jobs are then stopped by Main
+	int Main();
+
+	static std::string EscapeJSON(const std::string& value);
+};
+
+
+#endif /* DABLIN_SCAN_H_ */
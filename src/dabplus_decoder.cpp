@@ -37,6 +37,8 @@ SuperframeFilter::SuperframeFilter(SubchannelSinkObserver* observer, bool decode
 	sf_format_raw = 0;
 
 	num_aus = 0;
+
+	au_bw_header_bits = 0;
 }
 
 SuperframeFilter::~SuperframeFilter() {
@@ -105,6 +107,10 @@ void SuperframeFilter::Feed(const uint8_t *data, size_t len) {
 
 	if(sync_frames) {
 		fprintf(stderr, "SuperframeFilter: Superframe sync succeeded after %d frame(s)\n", sync_frames);
+
+		// the skipped frames since the last Superframe (if any) are lost
+		if(sf_format_set)
+			ForwardUntouchedStreamGap(sync_frames * 24);
 		sync_frames = 0;
 	}
 
@@ -126,6 +132,7 @@ void SuperframeFilter::Feed(const uint8_t *data, size_t len) {
 		uint16_t au_crc_calced = CalcCRC::CalcCRC_CRC16_CCITT.Calc(au_data, au_len - 2);
 		if(au_crc_stored != au_crc_calced) {
 			observer->AudioError("AU #" + std::to_string(i));
+			ForwardUntouchedStreamGap(sf_format.GetAULengthMs());
 			continue;
 		}
 
@@ -240,6 +247,9 @@ void SuperframeFilter::ProcessFormat() {
 	format.mode = !surround_mode.empty() ? (surround_mode + " (" + core_mode + " core)") : core_mode;
 	format.bitrate_kbps = sf_len / 120 * 8;
 	observer->FormatChange(format);
+	ForwardUntouchedStreamAudioFormat(format);
+
+	PrepareLATMHeader();
 
 	if(decode_audio) {
 		delete aac_dec;
@@ -253,12 +263,8 @@ void SuperframeFilter::ProcessFormat() {
 }
 
 
-void SuperframeFilter::ProcessUntouchedStream(const uint8_t *data, size_t len) {
-	std::lock_guard<std::mutex> lock(uscs_mutex);
-
-	if(uscs.empty())
-		return;
-
+void SuperframeFilter::PrepareLATMHeader() {
+	// the LATM header only depends on the format, so build it once as template
 	au_bw.Reset();
 
 	// AudioSyncStream()
@@ -295,6 +301,21 @@ void SuperframeFilter::ProcessUntouchedStream(const uint8_t *data, size_t len) {
 	au_bw.AddBits(0, 1);		// otherDataPresent
 	au_bw.AddBits(0, 1);		// crcCheckPresent
 
+	au_bw_header_bits = au_bw.GetBits();
+
+	// reserve space for the largest possible AU
+	au_bw.Reserve(sf_len / 255 + 1 + sf_len);
+}
+
+void SuperframeFilter::ProcessUntouchedStream(const uint8_t *data, size_t len) {
+	std::lock_guard<std::mutex> lock(uscs_mutex);
+
+	if(uscs.empty())
+		return;
+
+	// continue after the header template
+	au_bw.Rewind(au_bw_header_bits);
+
 	// PayloadLengthInfo()
 	for(size_t i = 0; i < len / 255; i++)
 		au_bw.AddBits(0xFF, 8);
@@ -306,8 +327,9 @@ void SuperframeFilter::ProcessUntouchedStream(const uint8_t *data, size_t len) {
 	// catch up on LATM frame len
 	au_bw.WriteAudioMuxLengthBytes();
 
-	const std::vector<uint8_t> latm_data = au_bw.GetData();
-	ForwardUntouchedStream(&latm_data[0], latm_data.size(), sf_format.GetAULengthMs());
+	// as the LATM header is not byte-aligned, the AU cannot be passed on separately
+	UNTOUCHED_STREAM_PART part = {au_bw.GetData(), au_bw.GetSize()};
+	ForwardUntouchedStream(&part, 1, sf_format.GetAULengthMs());
 }
 
 
@@ -361,8 +383,9 @@ void RSDecoder::DecodeSuperframe(uint8_t *sf, size_t sf_len, int& total_corr_cou
 
 // --- AACDecoder -----------------------------------------------------------------
 AACDecoder::AACDecoder(std::string decoder_name, SubchannelSinkObserver* observer, SuperframeFormat sf_format) {
-	fprintf(stderr, "AACDecoder: using decoder '%s'\n", decoder_name.c_str());
+	setup_start = std::chrono::steady_clock::now();
 
+	this->decoder_name = decoder_name;
 	this->observer = observer;
 
 	/* AudioSpecificConfig structure (the only way to select 960 transform here!)
@@ -408,46 +431,69 @@ AACDecoder::AACDecoder(std::string decoder_name, SubchannelSinkObserver* observe
 }
 
 
+void AACDecoder::PrintSetup(bool reused) {
+	double setup_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - setup_start).count();
+	fprintf(stderr, "AACDecoder: using decoder '%s' (%s handle, set up in %.3f ms)\n", decoder_name.c_str(), reused ? "reused" : "new", setup_ms);
+}
+
+
 #ifdef DABLIN_AAC_FAAD2
 // --- AACDecoderFAAD2 -----------------------------------------------------------------
+HandlePool<FAAD2_HANDLE>& AACDecoderFAAD2::GetHandlePool() {
+	static HandlePool<FAAD2_HANDLE> pool(4, [](FAAD2_HANDLE handle) {NeAACDecClose(handle.handle);});
+	return pool;
+}
+
 AACDecoderFAAD2::AACDecoderFAAD2(SubchannelSinkObserver* observer, SuperframeFormat sf_format) : AACDecoder("FAAD2", observer, sf_format) {
-	// ensure features
-	unsigned long cap = NeAACDecGetCapabilities();
-	if(!(cap & LC_DEC_CAP))
-		throw std::runtime_error("AACDecoderFAAD2: no LC decoding support!");
-
-	handle = NeAACDecOpen();
-	if(!handle)
-		throw std::runtime_error("AACDecoderFAAD2: error while NeAACDecOpen");
-
-	// set general config
-	NeAACDecConfigurationPtr config = NeAACDecGetCurrentConfiguration(handle);
-	if(!config)
-		throw std::runtime_error("AACDecoderFAAD2: error while NeAACDecGetCurrentConfiguration");
-
-	config->outputFormat = FAAD_FMT_16BIT;
-	config->dontUpSampleImplicitSBR = 0;
-
-	if(NeAACDecSetConfiguration(handle, config) != 1)
-		throw std::runtime_error("AACDecoderFAAD2: error while NeAACDecSetConfiguration");
-
-	// init decoder
-	unsigned long output_sr;
-	unsigned char output_ch;
-	long int init_result = NeAACDecInit2(handle, asc, asc_len, &output_sr, &output_ch);
-	if(init_result != 0)
-		throw std::runtime_error("AACDecoderFAAD2: error while NeAACDecInit2: " + std::string(NeAACDecGetErrorMessage(-init_result)));
-
-	observer->StartAudio(output_sr, output_ch);
+	// reuse an idle handle already initialized with the same ASC, if available
+	bool reused = GetHandlePool().Acquire(GetHandleKey(), handle);
+
+	// close the handle, if anything below fails (as the destructor is then not called)
+	std::unique_ptr<std::remove_pointer<NeAACDecHandle>::type, decltype(&NeAACDecClose)> handle_guard(reused ? handle.handle : nullptr, NeAACDecClose);
+	if(reused) {
+		NeAACDecPostSeekReset(handle.handle, 0);
+	} else {
+		// ensure features
+		unsigned long cap = NeAACDecGetCapabilities();
+		if(!(cap & LC_DEC_CAP))
+			throw std::runtime_error("AACDecoderFAAD2: no LC decoding support!");
+
+		handle.handle = NeAACDecOpen();
+		if(!handle.handle)
+			throw std::runtime_error("AACDecoderFAAD2: error while NeAACDecOpen");
+		handle_guard.reset(handle.handle);
+
+		// set general config
+		NeAACDecConfigurationPtr config = NeAACDecGetCurrentConfiguration(handle.handle);
+		if(!config)
+			throw std::runtime_error("AACDecoderFAAD2: error while NeAACDecGetCurrentConfiguration");
+
+		config->outputFormat = FAAD_FMT_16BIT;
+		config->dontUpSampleImplicitSBR = 0;
+
+		if(NeAACDecSetConfiguration(handle.handle, config) != 1)
+			throw std::runtime_error("AACDecoderFAAD2: error while NeAACDecSetConfiguration");
+
+		// init decoder
+		long int init_result = NeAACDecInit2(handle.handle, asc, asc_len, &handle.output_sr, &handle.output_ch);
+		if(init_result != 0)
+			throw std::runtime_error("AACDecoderFAAD2: error while NeAACDecInit2: " + std::string(NeAACDecGetErrorMessage(-init_result)));
+	}
+
+	PrintSetup(reused);
+
+	observer->StartAudio(handle.output_sr, handle.output_ch);
+
+	handle_guard.release();
 }
 
 AACDecoderFAAD2::~AACDecoderFAAD2() {
-	NeAACDecClose(handle);
+	GetHandlePool().Release(GetHandleKey(), handle);
 }
 
 void AACDecoderFAAD2::DecodeFrame(uint8_t *data, size_t len) {
 	// decode audio
-	uint8_t* output_frame = (uint8_t*) NeAACDecDecode(handle, &dec_frameinfo, data, len);
+	uint8_t* output_frame = (uint8_t*) NeAACDecDecode(handle.handle, &dec_frameinfo, data, len);
 	if(dec_frameinfo.error)
 		observer->AudioWarning("AAC");
 
@@ -466,50 +512,74 @@ void AACDecoderFAAD2::DecodeFrame(uint8_t *data, size_t len) {
 
 #ifdef DABLIN_AAC_FDKAAC
 // --- AACDecoderFDKAAC -----------------------------------------------------------------
-AACDecoderFDKAAC::AACDecoderFDKAAC(SubchannelSinkObserver* observer, SuperframeFormat sf_format) : AACDecoder("FDK-AAC", observer, sf_format) {
-	handle = aacDecoder_Open(TT_MP4_RAW, 1);
-	if(!handle)
-		throw std::runtime_error("AACDecoderFDKAAC: error while aacDecoder_Open");
+HandlePool<HANDLE_AACDECODER>& AACDecoderFDKAAC::GetHandlePool() {
+	static HandlePool<HANDLE_AACDECODER> pool(4, aacDecoder_Close);
+	return pool;
+}
 
+AACDecoderFDKAAC::AACDecoderFDKAAC(SubchannelSinkObserver* observer, SuperframeFormat sf_format) : AACDecoder("FDK-AAC", observer, sf_format) {
 	int channels = sf_format.aac_channel_mode || sf_format.ps_flag ? 2 : 1;
 	AAC_DECODER_ERROR init_result;
 
-	/* Restrict output channel count to actual input channel count.
-	 *
-	 * Just using the parameter value -1 (no up-/downmix) does not work, as with
-	 * SBR and Mono the lib assumes possibly present PS and then outputs Stereo!
-	 *
-	 * Note:
-	 * Older lib versions use a combined parameter for the output channel count.
-	 * As the headers of these didn't define the version, branch accordingly.
-	 */
+	// reuse an idle handle already configured with the same ASC, if available
+	bool reused = GetHandlePool().Acquire(GetHandleKey(), handle);
+
+	// close the handle, if anything below fails (as the destructor is then not called)
+	std::unique_ptr<std::remove_pointer<HANDLE_AACDECODER>::type, decltype(&aacDecoder_Close)> handle_guard(reused ? handle : nullptr, aacDecoder_Close);
+	if(reused) {
+		// discard any remaining data of the previous service
+		init_result = aacDecoder_SetParam(handle, AAC_TPDEC_CLEAR_BUFFER, 1);
+		if(init_result != AAC_DEC_OK)
+			throw std::runtime_error("AACDecoderFDKAAC: error while setting parameter AAC_TPDEC_CLEAR_BUFFER: " + std::to_string(init_result));
+	} else {
+		handle = aacDecoder_Open(TT_MP4_RAW, 1);
+		if(!handle)
+			throw std::runtime_error("AACDecoderFDKAAC: error while aacDecoder_Open");
+		handle_guard.reset(handle);
+
+		/* Restrict output channel count to actual input channel count.
+		 *
+		 * Just using the parameter value -1 (no up-/downmix) does not work, as with
+		 * SBR and Mono the lib assumes possibly present PS and then outputs Stereo!
+		 *
+		 * Note:
+		 * Older lib versions use a combined parameter for the output channel count.
+		 * As the headers of these didn't define the version, branch accordingly.
+		 */
 #if !defined(AACDECODER_LIB_VL0) && !defined(AACDECODER_LIB_VL1) && !defined(AACDECODER_LIB_VL2)
-	init_result = aacDecoder_SetParam(handle, AAC_PCM_OUTPUT_CHANNELS, channels);
-	if(init_result != AAC_DEC_OK)
-		throw std::runtime_error("AACDecoderFDKAAC: error while setting parameter AAC_PCM_OUTPUT_CHANNELS: " + std::to_string(init_result));
+		init_result = aacDecoder_SetParam(handle, AAC_PCM_OUTPUT_CHANNELS, channels);
+		if(init_result != AAC_DEC_OK)
+			throw std::runtime_error("AACDecoderFDKAAC: error while setting parameter AAC_PCM_OUTPUT_CHANNELS: " + std::to_string(init_result));
 #else
-	init_result = aacDecoder_SetParam(handle, AAC_PCM_MIN_OUTPUT_CHANNELS, channels);
-	if(init_result != AAC_DEC_OK)
-		throw std::runtime_error("AACDecoderFDKAAC: error while setting parameter AAC_PCM_MIN_OUTPUT_CHANNELS: " + std::to_string(init_result));
-	init_result = aacDecoder_SetParam(handle, AAC_PCM_MAX_OUTPUT_CHANNELS, channels);
-	if(init_result != AAC_DEC_OK)
-		throw std::runtime_error("AACDecoderFDKAAC: error while setting parameter AAC_PCM_MAX_OUTPUT_CHANNELS: " + std::to_string(init_result));
+		init_result = aacDecoder_SetParam(handle, AAC_PCM_MIN_OUTPUT_CHANNELS, channels);
+		if(init_result != AAC_DEC_OK)
+			throw std::runtime_error("AACDecoderFDKAAC: error while setting parameter AAC_PCM_MIN_OUTPUT_CHANNELS: " + std::to_string(init_result));
+		init_result = aacDecoder_SetParam(handle, AAC_PCM_MAX_OUTPUT_CHANNELS, channels);
+		if(init_result != AAC_DEC_OK)
+			throw std::runtime_error("AACDecoderFDKAAC: error while setting parameter AAC_PCM_MAX_OUTPUT_CHANNELS: " + std::to_string(init_result));
 #endif
 
-	uint8_t* asc_array[1] {asc};
-	const unsigned int asc_sizeof_array[1] {(unsigned int) asc_len};
-	init_result = aacDecoder_ConfigRaw(handle, asc_array, asc_sizeof_array);
-	if(init_result != AAC_DEC_OK)
-		throw std::runtime_error("AACDecoderFDKAAC: error while aacDecoder_ConfigRaw: " + std::to_string(init_result));
+		uint8_t* asc_array[1] {asc};
+		const unsigned int asc_sizeof_array[1] {(unsigned int) asc_len};
+		init_result = aacDecoder_ConfigRaw(handle, asc_array, asc_sizeof_array);
+		if(init_result != AAC_DEC_OK)
+			throw std::runtime_error("AACDecoderFDKAAC: error while aacDecoder_ConfigRaw: " + std::to_string(init_result));
+	}
 
 	output_frame_len = 960 * 2 * channels * (sf_format.sbr_flag ? 2 : 1);
 	output_frame = new uint8_t[output_frame_len];
+	std::unique_ptr<uint8_t[]> output_frame_guard(output_frame);
+
+	PrintSetup(reused);
 
 	observer->StartAudio(sf_format.dac_rate ? 48000 : 32000, channels);
+
+	output_frame_guard.release();
+	handle_guard.release();
 }
 
 AACDecoderFDKAAC::~AACDecoderFDKAAC() {
-	aacDecoder_Close(handle);
+	GetHandlePool().Release(GetHandleKey(), handle);
 	delete[] output_frame;
 }
 
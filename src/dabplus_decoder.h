@@ -22,6 +22,9 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdio.h>
+#include <chrono>
+#include <memory>
+#include <type_traits>
 #include <stdexcept>
 #include <string>
 
@@ -88,9 +91,15 @@ public:
 // --- AACDecoder -----------------------------------------------------------------
 class AACDecoder {
 protected:
+	std::string decoder_name;
 	SubchannelSinkObserver* observer;
 	uint8_t asc[7];
 	size_t asc_len;
+
+	std::chrono::steady_clock::time_point setup_start;
+
+	std::string GetHandleKey() {return std::string((const char*) asc, asc_len);}
+	void PrintSetup(bool reused);
 public:
 	AACDecoder(std::string decoder_name, SubchannelSinkObserver* observer, SuperframeFormat sf_format);
 	virtual ~AACDecoder() {}
@@ -101,10 +110,18 @@ public:
 
 #ifdef DABLIN_AAC_FAAD2
 // --- AACDecoderFAAD2 -----------------------------------------------------------------
+struct FAAD2_HANDLE {
+	NeAACDecHandle handle;
+	unsigned long output_sr;
+	unsigned char output_ch;
+};
+
 class AACDecoderFAAD2 : public AACDecoder {
 private:
-	NeAACDecHandle handle;
+	FAAD2_HANDLE handle;
 	NeAACDecFrameInfo dec_frameinfo;
+
+	static HandlePool<FAAD2_HANDLE>& GetHandlePool();
 public:
 	AACDecoderFAAD2(SubchannelSinkObserver* observer, SuperframeFormat sf_format);
 	~AACDecoderFAAD2();
@@ -121,6 +138,8 @@ private:
 	HANDLE_AACDECODER handle;
 	uint8_t *output_frame;
 	size_t output_frame_len;
+
+	static HandlePool<HANDLE_AACDECODER>& GetHandlePool();
 public:
 	AACDecoderFDKAAC(SubchannelSinkObserver* observer, SuperframeFormat sf_format);
 	~AACDecoderFDKAAC();
@@ -154,9 +173,11 @@ private:
 	int au_start[6+1]; // +1 for end of last AU
 
 	BitWriter au_bw;
+	size_t au_bw_header_bits;
 
 	bool CheckSync();
 	void ProcessFormat();
+	void PrepareLATMHeader();
 	void ProcessUntouchedStream(const uint8_t *data, size_t len);
 	void CheckForPAD(const uint8_t *data, size_t len);
 public:
@@ -25,31 +25,85 @@ EnsemblePlayer::EnsemblePlayer(AudioOutputType audio_output_type, bool disable_i
 	this->disable_int_catch_up = disable_int_catch_up;
 	this->observer = observer;
 
+	flow_control = true;
 	dec = nullptr;
 	out = nullptr;
+	tee_output = nullptr;
+	stdout_writer = nullptr;
 
+	player_start_time = std::chrono::steady_clock::now();
+	first_audio_pending = false;
+
+	if(audio_output_type != AudioOutputType::Untouched && audio_output_type != AudioOutputType::None && audio_output_type != AudioOutputType::UntouchedOnly)
+		out = CreateAudioOutput(audio_output_type, "");
+}
+
+AudioOutput* EnsemblePlayer::CreateAudioOutput(AudioOutputType audio_output_type, const std::string& filename) {
 	switch(audio_output_type) {
 #ifndef DABLIN_DISABLE_SDL
 	case AudioOutputType::SDL:
-		out = new SDLOutput;
-		break;
+		return new SDLOutput;
 #endif
 	case AudioOutputType::PCM:
-		out = new PCMOutput;
-		break;
+		return new PCMOutput(filename);
 	case AudioOutputType::WAV:
-		out = new WAVOutput;
-		break;
-	case AudioOutputType::Untouched:
-		break;
+		return new WAVOutput(filename);
 	default:
 		throw std::runtime_error("Unsupported audio output type!");
 	}
 }
 
+bool EnsemblePlayer::ParseAudioOutput(const std::string& spec, AudioOutputType& audio_output_type, std::string& filename) {
+	// "sdl", "pcm:<file>" or "wav:<file>"
+	if(spec == "sdl") {
+#ifdef DABLIN_DISABLE_SDL
+		return false;
+#else
+		audio_output_type = AudioOutputType::SDL;
+		filename = "";
+		return true;
+#endif
+	}
+
+	size_t colon = spec.find(':');
+	if(colon == std::string::npos || colon + 1 == spec.length())
+		return false;
+	std::string type = spec.substr(0, colon);
+	if(type == "pcm")
+		audio_output_type = AudioOutputType::PCM;
+	else if(type == "wav")
+		audio_output_type = AudioOutputType::WAV;
+	else
+		return false;
+	filename = spec.substr(colon + 1);
+	return true;
+}
+
+void EnsemblePlayer::AddAudioOutput(AudioOutputType audio_output_type, const std::string& filename) {
+	// the current output becomes the main output of a tee
+	if(!tee_output) {
+		tee_output = new TeeOutput;
+		if(out)
+			tee_output->AddOutput(out);
+		out = tee_output;
+	}
+	tee_output->AddOutput(CreateAudioOutput(audio_output_type, filename));
+}
+
 EnsemblePlayer::~EnsemblePlayer() {
 	delete dec;
 	delete out;
+	delete stdout_writer;
+}
+
+void EnsemblePlayer::EnableBatchedOutput(size_t batch_size, size_t flush_latency_ms) {
+	// only for output to stdout
+	if(audio_output_type == AudioOutputType::SDL || audio_output_type == AudioOutputType::None || audio_output_type == AudioOutputType::UntouchedOnly || stdout_writer)
+		return;
+
+	stdout_writer = new BatchedWriter(STDOUT_FILENO, batch_size, flush_latency_ms);
+	if(out)
+		out->SetBatchedWriter(stdout_writer);
 }
 
 bool EnsemblePlayer::IsSameAudioService(const AUDIO_SERVICE& audio_service) {
@@ -72,6 +126,10 @@ void EnsemblePlayer::SetAudioService(const AUDIO_SERVICE& audio_service) {
 		dec = nullptr;
 	}
 
+	// output the rest of the previous service
+	if(stdout_writer)
+		stdout_writer->Flush();
+
 	if(audio_service.IsNone())
 		fprintf(stderr, "EnsemblePlayer: playing nothing\n");
 	else
@@ -80,17 +138,56 @@ void EnsemblePlayer::SetAudioService(const AUDIO_SERVICE& audio_service) {
 	// apply
 	if(!audio_service.IsNone()) {
 		if(audio_service.dab_plus)
-			dec = new SuperframeFilter(this, audio_output_type != AudioOutputType::Untouched);
+			dec = new SuperframeFilter(this, audio_output_type != AudioOutputType::Untouched && audio_output_type != AudioOutputType::UntouchedOnly);
 		else
 			dec = new MP2Decoder(this);
 		if(audio_output_type == AudioOutputType::Untouched)
 			dec->AddUntouchedStreamConsumer(this);
+		for(UntouchedStreamConsumer* consumer : service_uscs)
+			dec->AddUntouchedStreamConsumer(consumer);
+
+		service_start_time = std::chrono::steady_clock::now();
 	}
+	first_audio_pending = !audio_service.IsNone();
+
+	for(UntouchedStreamConsumer* consumer : service_uscs)
+		consumer->UntouchedStreamChangeFormat(dec ? dec->GetUntouchedStreamFileExtension() : "");
 
 	this->audio_service = audio_service;
 }
 
+void EnsemblePlayer::AddServiceUntouchedStreamConsumer(UntouchedStreamConsumer* consumer) {
+	std::lock_guard<std::mutex> lock(audio_service_mutex);
+
+	service_uscs.push_back(consumer);
+	consumer->UntouchedStreamChangeFormat(dec ? dec->GetUntouchedStreamFileExtension() : "");
+	if(dec)
+		dec->AddUntouchedStreamConsumer(consumer);
+}
+
+void EnsemblePlayer::RemoveServiceUntouchedStreamConsumer(UntouchedStreamConsumer* consumer) {
+	std::lock_guard<std::mutex> lock(audio_service_mutex);
+
+	for(auto it = service_uscs.begin(); it != service_uscs.end(); it++) {
+		if(*it == consumer) {
+			service_uscs.erase(it);
+			break;
+		}
+	}
+	if(dec)
+		dec->RemoveUntouchedStreamConsumer(consumer);
+}
+
 void EnsemblePlayer::ProcessFrame(const uint8_t *data) {
+	// also apply the max latency of batched output, if there is (currently) no further output
+	if(stdout_writer)
+		stdout_writer->FlushIfDue();
+
+	if(!flow_control) {
+		DecodeFrame(data);
+		return;
+	}
+
 	bool init = next_frame_time.time_since_epoch().count() == 0;
 	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
 
@@ -115,6 +212,34 @@ void EnsemblePlayer::FormatChange(const AUDIO_SERVICE_FORMAT& format) {
 		observer->EnsembleChangeFormat(format);
 }
 
+void EnsemblePlayer::CheckFirstAudio() {
+	if(!first_audio_pending)
+		return;
+	first_audio_pending = false;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	long int since_player_start = std::chrono::duration_cast<std::chrono::milliseconds>(now - player_start_time).count();
+	long int since_service_start = std::chrono::duration_cast<std::chrono::milliseconds>(now - service_start_time).count();
+	fprintf(stderr, "EnsemblePlayer: time to first audio: %ld ms (since service selection: %ld ms)\n", since_player_start, since_service_start);
+}
+
+void EnsemblePlayer::StartAudio(int samplerate, int channels) {
+	if(out)
+		out->StartAudio(samplerate, channels);
+	if(observer)
+		observer->EnsembleStartAudio(samplerate, channels);
+}
+
+void EnsemblePlayer::PutAudio(const uint8_t *data, size_t len) {
+	// called from within DecodeFrame i.e. with audio_service_mutex held
+	CheckFirstAudio();
+
+	if(out)
+		out->PutAudio(data, len);
+	if(observer)
+		observer->EnsemblePutAudio(data, len);
+}
+
 void EnsemblePlayer::ProcessFIC(const uint8_t *data, size_t len) {
 //	fprintf(stderr, "Received %zu bytes FIC\n", len);
 	if(observer)
@@ -127,10 +252,48 @@ void EnsemblePlayer::ProcessPAD(const uint8_t *xpad_data, size_t xpad_len, bool
 		observer->EnsembleProcessPAD(xpad_data, xpad_len, exact_xpad_len, fpad_data);
 }
 
-void EnsemblePlayer::ProcessUntouchedStream(const uint8_t* data, size_t len, size_t /*duration_ms*/) {
-	if(audio_output_type == AudioOutputType::Untouched) {
-		if(fwrite(data, len, 1, stdout) != 1)
+void EnsemblePlayer::ProcessUntouchedStream(const uint8_t* data, size_t len, size_t duration_ms) {
+	UNTOUCHED_STREAM_PART part = {data, len};
+	ProcessUntouchedStreamParts(&part, 1, duration_ms);
+}
+
+void EnsemblePlayer::ProcessUntouchedStreamParts(const UNTOUCHED_STREAM_PART* parts, size_t count, size_t /*duration_ms*/) {
+	if(audio_output_type != AudioOutputType::Untouched)
+		return;
+
+	CheckFirstAudio();
+
+	if(stdout_writer) {
+		for(size_t i = 0; i < count; i++)
+			stdout_writer->Write(parts[i].data, parts[i].len);
+		return;
+	}
+
+	// write all parts at once, without joining them before
+	untouched_iov.resize(count);
+	for(size_t i = 0; i < count; i++) {
+		untouched_iov[i].iov_base = (void*) parts[i].data;
+		untouched_iov[i].iov_len = parts[i].len;
+	}
+
+	size_t iov_index = 0;
+	while(iov_index < count) {
+		ssize_t written = writev(STDOUT_FILENO, &untouched_iov[iov_index], count - iov_index);
+		if(written == -1) {
+			if(errno == EINTR)
+				continue;
 			perror("EnsemblePlayer: error while writing untouched stream to stdout");
+			return;
+		}
+
+		// skip parts already written completely; adjust partially written part
+		size_t written_len = written;
+		while(iov_index < count && written_len >= untouched_iov[iov_index].iov_len)
+			written_len -= untouched_iov[iov_index++].iov_len;
+		if(iov_index < count) {
+			untouched_iov[iov_index].iov_base = (uint8_t*) untouched_iov[iov_index].iov_base + written_len;
+			untouched_iov[iov_index].iov_len -= written_len;
+		}
 	}
 }
 
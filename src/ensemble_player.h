@@ -24,22 +24,29 @@
 #include "sdl_output.h"
 #endif
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <chrono>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "subchannel_sink.h"
 #include "dab_decoder.h"
 #include "dabplus_decoder.h"
 #include "pcm_output.h"
 #include "wav_output.h"
+#include "batched_writer.h"
+#include "tee_output.h"
 #include "tools.h"
 
 
 // --- AudioOutputType -----------------------------------------------------------------
-enum class AudioOutputType { SDL, PCM, WAV, Untouched };
+enum class AudioOutputType { SDL, PCM, WAV, Untouched, None, UntouchedOnly };	// None: decoded audio only for the observer; UntouchedOnly: untouched stream only for the consumers
 
 
 // --- EnsemblePlayerObserver -----------------------------------------------------------------
@@ -50,6 +57,8 @@ public:
 	virtual void EnsembleChangeFormat(const AUDIO_SERVICE_FORMAT& /*format*/) {}
 	virtual void EnsembleProcessFIC(const uint8_t* /*data*/, size_t /*len*/) {}
 	virtual void EnsembleProcessPAD(const uint8_t* /*xpad_data*/, size_t /*xpad_len*/, bool /*exact_xpad_len*/, const uint8_t* /*fpad_data*/) {}
+	virtual void EnsembleStartAudio(int /*samplerate*/, int /*channels*/) {}
+	virtual void EnsemblePutAudio(const uint8_t* /*data*/, size_t /*len*/) {}
 };
 
 
@@ -58,6 +67,7 @@ class EnsemblePlayer : SubchannelSinkObserver, UntouchedStreamConsumer {
 protected:
 	AudioOutputType audio_output_type;
 	bool disable_int_catch_up;
+	bool flow_control;
 	EnsemblePlayerObserver *observer;
 
 	std::chrono::steady_clock::time_point next_frame_time;
@@ -65,18 +75,32 @@ protected:
 	std::mutex audio_service_mutex;
 	AUDIO_SERVICE audio_service;
 
+	// time to first audio (guarded by audio_service_mutex)
+	std::chrono::steady_clock::time_point player_start_time;
+	std::chrono::steady_clock::time_point service_start_time;
+	bool first_audio_pending;
+
+	void CheckFirstAudio();
+
 	SubchannelSink *dec;
 	AudioOutput *out;
+	TeeOutput *tee_output;	// only if several outputs
+	BatchedWriter *stdout_writer;
+	std::vector<struct iovec> untouched_iov;
+	std::vector<UntouchedStreamConsumer*> service_uscs;	// kept across services
+
+	static AudioOutput* CreateAudioOutput(AudioOutputType audio_output_type, const std::string& filename);
 
 	virtual void DecodeFrame(const uint8_t *ensemble_frame) = 0;
 
 	void FormatChange(const AUDIO_SERVICE_FORMAT& format);
-	void StartAudio(int samplerate, int channels) {if(out) out->StartAudio(samplerate, channels);}
-	void PutAudio(const uint8_t *data, size_t len) {if(out) out->PutAudio(data, len);}
+	void StartAudio(int samplerate, int channels);
+	void PutAudio(const uint8_t *data, size_t len);
 
 	void ProcessFIC(const uint8_t *data, size_t len);
 	void ProcessPAD(const uint8_t *xpad_data, size_t xpad_len, bool exact_xpad_len, const uint8_t *fpad_data);
 	void ProcessUntouchedStream(const uint8_t* data, size_t len, size_t duration_ms);
+	void ProcessUntouchedStreamParts(const UNTOUCHED_STREAM_PART* parts, size_t count, size_t duration_ms);
 
 	void AudioError(const std::string& hint);
 	void AudioWarning(const std::string& hint);
@@ -86,6 +110,9 @@ public:
 	~EnsemblePlayer();
 
 	void ProcessFrame(const uint8_t *data);
+	void DisableFlowControl() {flow_control = false;}	// process frames as fast as they arrive (e.g. for scanning)
+	void AddAudioOutput(AudioOutputType audio_output_type, const std::string& filename);	// in addition to the main output
+	static bool ParseAudioOutput(const std::string& spec, AudioOutputType& audio_output_type, std::string& filename);
 
 	bool IsSameAudioService(const AUDIO_SERVICE& audio_service);
 	void SetAudioService(const AUDIO_SERVICE& audio_service);
@@ -93,11 +120,16 @@ public:
 	std::string GetUntouchedStreamFileExtension() {return dec ? dec->GetUntouchedStreamFileExtension() : "";}
 	void AddUntouchedStreamConsumer(UntouchedStreamConsumer* consumer) {if(dec) dec->AddUntouchedStreamConsumer(consumer);};
 	void RemoveUntouchedStreamConsumer(UntouchedStreamConsumer* consumer) {if(dec) dec->RemoveUntouchedStreamConsumer(consumer);};
+	void AddServiceUntouchedStreamConsumer(UntouchedStreamConsumer* consumer);	// also for all following services
+	void RemoveServiceUntouchedStreamConsumer(UntouchedStreamConsumer* consumer);
 
 	void StopAudio() {if(out) out->StopAudio();}
 	void SetAudioMute(bool audio_mute) {if(out) out->SetAudioMute(audio_mute);}
 	void SetAudioVolume(double audio_volume) {if(out) out->SetAudioVolume(audio_volume);}
 	bool HasAudioVolumeControl() {return out ? out->HasAudioVolumeControl() : false;}
+	void SetAudioLatency(size_t audio_latency_ms) {if(out) out->SetAudioLatency(audio_latency_ms);}
+	void SetFixedOutputFormat(bool fixed_output_format) {if(out) out->SetFixedOutputFormat(fixed_output_format);}
+	void EnableBatchedOutput(size_t batch_size, size_t flush_latency_ms);
 };
 
 #endif /* ENSEMBLE_PLAYER_H_ */
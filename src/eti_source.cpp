@@ -45,6 +45,10 @@ void DABLiveETISource::PrintSource() {
 }
 
 DABLiveETISource::~DABLiveETISource() {
+	// source only started, if Init() was called
+	if(!input_file)
+		return;
+
 	// kill source, if not yet terminated
 	if(!feof(input_file)) {
 		// TODO: replace bad style temporary solution (here possible, because dab2eti allows only one concurrent session)
@@ -19,12 +19,58 @@
 #include "fic_decoder.h"
 
 
+// --- FIC_FIG_STATS -----------------------------------------------------------------
+const size_t FIC_FIG_STATS::recent_repetitions_count = 16;
+
+void FIC_FIG_STATS::AddRepetition(size_t repetition_ms) {
+	repeats++;
+	repetition_ms_sum += repetition_ms;
+	repetition_ms_max = std::max(repetition_ms_max, repetition_ms);
+
+	// the carousel may change over time, so only consider recent repetitions for it
+	recent_repetitions_ms.push_back(repetition_ms);
+	if(recent_repetitions_ms.size() > recent_repetitions_count)
+		recent_repetitions_ms.pop_front();
+}
+
+size_t FIC_FIG_STATS::GetRecentRepetitionMs() const {
+	size_t result = 0;
+	for(size_t repetition_ms : recent_repetitions_ms)
+		result = std::max(result, repetition_ms);
+	return result;
+}
+
+
 // --- FICDecoder -----------------------------------------------------------------
+FICDecoder::~FICDecoder() {
+	if(fig_cache_lookups)
+		fprintf(stderr, "FICDecoder: FIG cache: %zu of %zu FIGs skipped (%.1f%%)\n", fig_cache_hits, fig_cache_lookups, 100.0 * fig_cache_hits / fig_cache_lookups);
+}
+
 void FICDecoder::Reset() {
+	ClearFIGCache();
 	ensemble = FIC_ENSEMBLE();
 	services.clear();
-	subchannels.clear();
+	service_indices.clear();
+	for(FIC_SUBCHANNEL& sc : subchannels)
+		sc = FIC_SUBCHANNEL();
+	for(fic_service_refs_t& refs : subchannel_services)
+		refs.clear();
+	for(fic_service_refs_t& refs : cluster_services)
+		refs.clear();
 	utc_dt = FIC_DAB_DT();
+
+	last_change_ms = fic_time_ms;
+	fig_stats.clear();
+	fig_instances.clear();
+	completeness = FIC_COMPLETENESS();
+
+	ensemble_update_pending = false;
+	pending_services.clear();
+	emitted_ensemble = FIC_ENSEMBLE();
+	emitted_listed_services.clear();
+
+	cache_speculative = false;
 }
 
 void FICDecoder::Process(const uint8_t *data, size_t len) {
@@ -34,8 +80,109 @@ void FICDecoder::Process(const uint8_t *data, size_t len) {
 		return;
 	}
 
+	fic_time_ms += 24;
+
 	for(size_t i = 0; i < len; i += 32)
 		ProcessFIB(data + i);
+
+	EmitUpdates();
+	UpdateCompleteness();
+}
+
+void FICDecoder::EmitUpdates() {
+	// ensemble
+	if(ensemble_update_pending) {
+		ensemble_update_pending = false;
+
+		// abort update, if EId or label not yet present
+		if(!ensemble.IsNone() && !ensemble.label.IsNone() && ensemble != emitted_ensemble) {
+			emitted_ensemble = ensemble;
+			last_change_ms = fic_time_ms;
+			observer->FICChangeEnsemble(ensemble);
+		}
+	}
+
+	// services
+	if(pending_services.empty())
+		return;
+
+	changed_listed_services.clear();
+	for(size_t service_index : pending_services) {
+		FIC_SERVICE& service = services[service_index];
+		service.update_pending = false;
+		ListService(service);
+	}
+	pending_services.clear();
+
+	if(!changed_listed_services.empty()) {
+		last_change_ms = fic_time_ms;
+		observer->FICChangeServices(changed_listed_services, ++services_version);
+	}
+}
+
+void FICDecoder::UpdateCompleteness() {
+	FIC_COMPLETENESS new_completeness;
+	new_completeness.elapsed_ms = fic_time_ms;
+
+	// resolved elements: ensemble EId/label; per service primary component, sub-channel and label
+	size_t elements = 2;
+	size_t elements_resolved = (ensemble.IsNone() ? 0 : 1) + (ensemble.label.IsNone() ? 0 : 1);
+	size_t required_elements = elements;
+	size_t required_elements_resolved = elements_resolved;
+	for(const FIC_SERVICE& service : services) {
+		// ignore services without audio component (e.g. only labelled)
+		if(service.audio_comps.empty())
+			continue;
+		new_completeness.services++;
+
+		/* The sub-channel details (FIG 0/1) only add to the confidence, as
+		 * some ensembles lack them for single services - which then still
+		 * can be listed and played.
+		 */
+		bool pri_comp = !service.HasNoPriCompSubchid();
+		bool subchannel = pri_comp && subchannels[service.pri_comp_subchid].bitrate != -1;
+		bool label = !service.label.IsNone();
+		elements += 3;
+		elements_resolved += pri_comp + subchannel + label;
+		required_elements += 2;
+		required_elements_resolved += pri_comp + label;
+		if(pri_comp && label)
+			new_completeness.services_resolved++;
+	}
+
+	// carousel cycle: all FIGs needed for the service list must have been repeated at least once
+	bool carousel_known = true;
+	static const std::pair<int,int> carousel_figs[] = {{0, 0}, {0, 1}, {0, 2}, {1, 0}, {1, 1}};
+	for(const std::pair<int,int>& carousel_fig : carousel_figs) {
+		fig_stats_t::const_iterator it = fig_stats.find(carousel_fig);
+		if(it == fig_stats.cend() || !it->second.IsRepeated()) {
+			carousel_known = false;
+			break;
+		}
+		new_completeness.carousel_ms = std::max(new_completeness.carousel_ms, it->second.GetRecentRepetitionMs());
+	}
+
+	// confidence: resolved share, weighted by how much of a carousel cycle passed without any change
+	size_t unchanged_ms = fic_time_ms - last_change_ms;
+	double settled = carousel_known ? std::min(1.0, (double) unchanged_ms / new_completeness.carousel_ms) : 0.0;
+	new_completeness.confidence = (double) elements_resolved / elements * settled;
+
+	new_completeness.complete =
+			!cache_speculative &&
+			new_completeness.services &&
+			required_elements_resolved == required_elements &&
+			carousel_known &&
+			unchanged_ms >= new_completeness.carousel_ms;
+
+	bool complete_changed = new_completeness.complete != completeness.complete;
+	completeness = new_completeness;
+
+	if(complete_changed) {
+		fprintf(stderr, "FICDecoder: ensemble %s after %zu ms (%zu/%zu services resolved, carousel %zu ms)\n",
+				completeness.complete ? "complete" : "no longer complete", completeness.elapsed_ms,
+				completeness.services_resolved, completeness.services, completeness.carousel_ms);
+		observer->FICChangeCompleteness(completeness);
+	}
 }
 
 
@@ -44,6 +191,7 @@ void FICDecoder::ProcessFIB(const uint8_t *data) {
 	uint16_t crc_stored = data[30] << 8 | data[31];
 	uint16_t crc_calced = CalcCRC::CalcCRC_CRC16_CCITT.Calc(data, 30);
 	if(crc_stored != crc_calced) {
+		last_error_ms = fic_time_ms;
 		observer->FICDiscardedFIB();
 		return;
 	}
@@ -52,6 +200,17 @@ void FICDecoder::ProcessFIB(const uint8_t *data) {
 	for(size_t offset = 0; offset < 30 && data[offset] != 0xFF;) {
 		int type = data[offset] >> 5;
 		size_t len = data[offset] & 0x1F;
+
+		size_t fig_len = std::min(len + 1, 30 - offset);
+		uint64_t fig_hash = HashFIG(data + offset, fig_len);
+		bool fig_cacheable = IsFIGCacheable(data + offset, fig_len);
+		UpdateFIGStats(data + offset, fig_len, fig_hash, !fig_cacheable);
+
+		// skip FIG, if its content then has no effect
+		if(fig_cacheable && CheckFIGCache(data + offset, fig_len, fig_hash)) {
+			offset += 1 + len;
+			continue;
+		}
 		offset++;
 
 		switch(type) {
@@ -69,6 +228,96 @@ void FICDecoder::ProcessFIB(const uint8_t *data) {
 }
 
 
+bool FICDecoder::IsFIGCacheable(const uint8_t *data, size_t len) {
+	// time-varying FIGs must always be processed: FIG 0/0 (CIF count), FIG 0/10 (date/time)
+	if(data[0] >> 5 == 0 && len >= 2) {
+		int extension = data[1] & 0x1F;
+		if(extension == 0 || extension == 10)
+			return false;
+	}
+	return true;
+}
+
+uint64_t FICDecoder::HashFIG(const uint8_t *data, size_t len) {
+	// FNV-1a over the whole FIG (incl. type/len and extension)
+	uint64_t hash = 0xCBF29CE484222325;
+	for(size_t i = 0; i < len; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001B3;
+	}
+	return hash;
+}
+
+bool FICDecoder::CheckFIGCache(const uint8_t *data, size_t len, uint64_t hash) {
+	/* A FIG is only skipped, if identical to the last one with the same header and first entity (e.g. SId)
+	 * and if no FIG of the same type/extension had new content since. Otherwise e.g. an announcement
+	 * switched on, off and on again, or entities regrouped among FIGs, could be missed.
+	 */
+	fig_cache_lookups++;
+
+	uint32_t key = 0;
+	for(size_t i = 0; i < 4; i++)
+		key = key << 8 | (i < len ? data[i] : 0x00);
+	int type = data[0] >> 5;
+	int extension = len < 2 ? -1 : (type == 0 ? data[1] & 0x1F : data[1] & 0x07);
+	size_t& generation = fig_cache_generations[type << 5 | (extension & 0x1F)];
+
+	fig_cache_t::iterator it = fig_cache.find(key);
+	if(it != fig_cache.end() && it->second.hash == hash && it->second.generation == generation) {
+		fig_cache_hits++;
+		return true;
+	}
+
+	// new content invalidates all entries of the same type/extension
+	if(it == fig_cache.end() || it->second.hash != hash)
+		generation++;
+
+	// limit the tracked entries (for frequently changing content)
+	if(fig_cache.size() >= 4096)
+		fig_cache.clear();
+	fig_cache[key] = {hash, generation};
+	return false;
+}
+
+void FICDecoder::ClearFIGCache() {
+	fig_cache.clear();
+	fig_cache_generations.clear();
+}
+
+void FICDecoder::UpdateFIGStats(const uint8_t *data, size_t len, uint64_t hash, bool time_varying) {
+	// FIG types 0/1 only; extension in the first field byte
+	int type = data[0] >> 5;
+	if(len < 2 || type > 1)
+		return;
+	int extension = type == 0 ? data[1] & 0x1F : data[1] & 0x07;
+
+	FIC_FIG_STATS& stats = fig_stats[std::make_pair(type, extension)];
+
+	/* repetition time:
+	 * - time-varying FIGs (e.g. CIF count, date/time): since the last FIG of that type
+	 * - otherwise: since the last FIG with identical content
+	 */
+	size_t prev_seen_ms = 0;
+	if(time_varying) {
+		prev_seen_ms = stats.count ? stats.last_seen_ms : 0;
+	} else {
+		// limit the tracked instances (for frequently changing content)
+		if(fig_instances.size() >= 4096)
+			fig_instances.clear();
+
+		size_t& instance_seen_ms = fig_instances[hash];
+		prev_seen_ms = instance_seen_ms;
+		instance_seen_ms = fic_time_ms;
+	}
+
+	// multiple instances within the same frame are no repetition
+	if(prev_seen_ms && prev_seen_ms < fic_time_ms && last_error_ms <= prev_seen_ms)
+		stats.AddRepetition(fic_time_ms - prev_seen_ms);
+
+	stats.count++;
+	stats.last_seen_ms = fic_time_ms;
+}
+
 void FICDecoder::ProcessFIG0(const uint8_t *data, size_t len) {
 	if(len < 1) {
 		fprintf(stderr, "FICDecoder: received empty FIG 0\n");
@@ -132,8 +381,22 @@ void FICDecoder::ProcessFIG0_0(const uint8_t *data, size_t len) {
 	if(len < 4)
 		return;
 
+	uint16_t eid = data[0] << 8 | data[1];
+
+	// check a speculatively used cache against the actual ensemble
+	if(cache_speculative) {
+		if(ensemble.eid == eid) {
+			fprintf(stderr, "FICDecoder: EId 0x%04X: cached ensemble confirmed\n", eid);
+			cache_speculative = false;
+		} else {
+			fprintf(stderr, "FICDecoder: EId 0x%04X: cached ensemble (EId 0x%04X) contradicted; discarding cache\n", eid, ensemble.eid);
+			Reset();
+			observer->FICResetEnsemble();
+		}
+	}
+
 	FIC_ENSEMBLE new_ensemble = ensemble;
-	new_ensemble.eid = data[0] << 8 | data[1];
+	new_ensemble.eid = eid;
 	new_ensemble.al_flag = data[2] & 0x20;
 
 	if(ensemble != new_ensemble) {
@@ -235,7 +498,13 @@ void FICDecoder::ProcessFIG0_2(const uint8_t *data, size_t len) {
 
 						AUDIO_SERVICE audio_service(subchid, dab_plus);
 
-						FIC_SERVICE& service = GetService(sid);
+						size_t service_index = GetServiceIndex(sid);
+						FIC_SERVICE& service = services[service_index];
+
+						// if new component, add reverse reference
+						if(service.audio_comps.find(subchid) == service.audio_comps.end())
+							subchannel_services[subchid].push_back(service_index);
+
 						AUDIO_SERVICE& current_audio_service = service.audio_comps[subchid];
 						if(current_audio_service != audio_service || ps != (service.pri_comp_subchid == subchid)) {
 							current_audio_service = audio_service;
@@ -358,8 +627,7 @@ void FICDecoder::ProcessFIG0_9(const uint8_t *data, size_t len) {
 		UpdateEnsemble();
 
 		// update services that changes may affect
-		for(const fic_services_t::value_type& service : services) {
-			const FIC_SERVICE& s = service.second;
+		for(const FIC_SERVICE& s : services) {
 			if(s.pty_static != FIC_SERVICE::pty_none || s.pty_dynamic != FIC_SERVICE::pty_none)
 				UpdateService(s);
 		}
@@ -518,10 +786,19 @@ void FICDecoder::ProcessFIG0_18(const uint8_t *data, size_t len) {
 		for(size_t i = 0; i < number_of_clusters; i++)
 			cids.emplace(data[offset++]);
 
-		FIC_SERVICE& service = GetService(sid);
+		size_t service_index = GetServiceIndex(sid);
+		FIC_SERVICE& service = services[service_index];
 		uint16_t& current_asu_flags = service.asu_flags;
 		cids_t& current_cids = service.cids;
 		if(current_asu_flags != asu_flags || current_cids != cids) {
+			// update reverse references
+			for(const cids_t::value_type& cid : current_cids) {
+				fic_service_refs_t& refs = cluster_services[cid];
+				refs.erase(std::remove(refs.begin(), refs.end(), service_index), refs.end());
+			}
+			for(const cids_t::value_type& cid : cids)
+				cluster_services[cid].push_back(service_index);
+
 			current_asu_flags = asu_flags;
 			current_cids = cids;
 
@@ -569,11 +846,8 @@ void FICDecoder::ProcessFIG0_19(const uint8_t *data, size_t len) {
 			UpdateEnsemble();
 
 			// update services that changes may affect
-			for(const fic_services_t::value_type& service : services) {
-				const FIC_SERVICE& s = service.second;
-				if(s.cids.find(cid) != s.cids.cend())
-					UpdateService(s);
-			}
+			for(size_t service_index : cluster_services[cid])
+				UpdateService(services[service_index]);
 		}
 	}
 }
@@ -688,31 +962,42 @@ void FICDecoder::ProcessFIG1_4(uint16_t sid, int scids, const FIC_LABEL& label)
 }
 
 FIC_SUBCHANNEL& FICDecoder::GetSubchannel(int subchid) {
-	// created automatically, if not yet existing
+	// SubChId is a 6-bit field, so always within the array
 	return subchannels[subchid];
 }
 
 void FICDecoder::UpdateSubchannel(int subchid) {
 	// update services that consist of this sub-channel
-	for(const fic_services_t::value_type& service : services) {
-		const FIC_SERVICE& s = service.second;
-		if(s.audio_comps.find(subchid) != s.audio_comps.end())
-			UpdateService(s);
-	}
+	for(size_t service_index : subchannel_services[subchid])
+		UpdateService(services[service_index]);
 }
 
-FIC_SERVICE& FICDecoder::GetService(uint16_t sid) {
-	FIC_SERVICE& result = services[sid];	// created, if not yet existing
-
-	// if new service, set SID
-	if(result.IsNone())
-		result.sid = sid;
-	return result;
+size_t FICDecoder::GetServiceIndex(uint16_t sid) {
+	fic_service_indices_t::const_iterator it = service_indices.find(sid);
+	if(it != service_indices.cend())
+		return it->second;
+
+	// if new service, create it and set SID
+	size_t index = services.size();
+	services.emplace_back();
+	services[index].sid = sid;
+	service_indices[sid] = index;
+	return index;
 }
 
 void FICDecoder::UpdateService(const FIC_SERVICE& service) {
-	// abort update, if primary component or label not yet present
-	if(service.HasNoPriCompSubchid() || service.label.IsNone())
+	// just mark the service; emitted after the current FIC data has been processed
+	size_t service_index = service_indices.at(service.sid);
+	FIC_SERVICE& s = services[service_index];
+	if(!s.update_pending) {
+		s.update_pending = true;
+		pending_services.push_back(service_index);
+	}
+}
+
+void FICDecoder::ListService(const FIC_SERVICE& service) {
+	// abort update, if primary component not yet present (the label may follow later)
+	if(service.HasNoPriCompSubchid())
 		return;
 
 	// secondary components (if both component and definition are present)
@@ -753,9 +1038,7 @@ void FICDecoder::UpdateListedService(const FIC_SERVICE& service, int scids, bool
 	}
 
 	// use sub-channel information, if available
-	fic_subchannels_t::const_iterator sc_it = subchannels.find(ls.audio_service.subchid);
-	if(sc_it != subchannels.end())
-		ls.subchannel = sc_it->second;
+	ls.subchannel = subchannels[ls.audio_service.subchid];
 
 	/* check (for) Slideshow; currently only supported in X-PAD
 	 * - derive the required SCIdS (if not yet known)
@@ -773,8 +1056,12 @@ void FICDecoder::UpdateListedService(const FIC_SERVICE& service, int scids, bool
 	if(sls_scids != LISTED_SERVICE::scids_none && service.comp_sls_uas.find(sls_scids) != service.comp_sls_uas.end())
 		ls.sls_app_type = GetSLSAppType(service.comp_sls_uas.at(sls_scids));
 
-	// forward to observer
-	observer->FICChangeService(ls);
+	// collect, if changed
+	LISTED_SERVICE& emitted_ls = emitted_listed_services[std::make_pair(ls.sid, ls.scids)];
+	if(emitted_ls != ls) {
+		emitted_ls = ls;
+		changed_listed_services.push_back(ls);
+	}
 }
 
 int FICDecoder::GetSLSAppType(const ua_data_t& ua_data) {
@@ -800,23 +1087,259 @@ int FICDecoder::GetSLSAppType(const ua_data_t& ua_data) {
 }
 
 void FICDecoder::UpdateEnsemble() {
-	// abort update, if EId or label not yet present
-	if(ensemble.IsNone() || ensemble.label.IsNone())
-		return;
+	// emitted after the current FIC data has been processed
+	ensemble_update_pending = true;
+}
+
+const uint8_t FICDecoder::cache_magic[] = {'D', 'A', 'B', 'l', 'i', 'n', 'F', 'C'};
+const int FICDecoder::cache_version = 1;
+
+bool FICDecoder::SaveCache(const std::string& filename) {
+	// only a known ensemble is worth caching
+	if(ensemble.IsNone())
+		return false;
+
+	FICCacheWriter w;
+	w.PutBytes(cache_magic, sizeof(cache_magic));
+	w.Put8(cache_version);
+
+	// ensemble
+	w.Put16(ensemble.eid);
+	w.PutLabel(ensemble.label);
+	w.Put16(ensemble.ecc);
+	w.Put16(ensemble.lto);
+	w.Put16(ensemble.inter_table_id);
+
+	// sub-channels
+	int subchannel_count = 0;
+	for(const FIC_SUBCHANNEL& sc : subchannels)
+		if(!sc.IsNone())
+			subchannel_count++;
+	w.Put8(subchannel_count);
+	for(int subchid = 0; subchid < 64; subchid++) {
+		const FIC_SUBCHANNEL& sc = subchannels[subchid];
+		if(sc.IsNone())
+			continue;
+		w.Put8(subchid);
+		w.Put16(sc.start);
+		w.Put16(sc.size);
+		w.PutString(sc.pl);
+		w.Put16(sc.bitrate);
+		w.Put16(sc.language);
+	}
+
+	// services (dynamic PTY and announcement switching omitted)
+	w.Put16(services.size());
+	for(const FIC_SERVICE& service : services) {
+		w.Put16(service.sid);
+		w.Put16(service.pri_comp_subchid);
+		w.PutLabel(service.label);
+		w.Put16(service.pty_static);
+		w.Put16(service.asu_flags);
+
+		w.Put8(service.cids.size());
+		for(const cids_t::value_type& cid : service.cids)
+			w.Put8(cid);
+
+		w.Put8(service.audio_comps.size());
+		for(const audio_comps_t::value_type& audio_comp : service.audio_comps) {
+			w.Put8(audio_comp.first);
+			w.Put8(audio_comp.second.dab_plus);
+		}
+
+		w.Put8(service.comp_defs.size());
+		for(const comp_defs_t::value_type& comp_def : service.comp_defs) {
+			w.Put8(comp_def.first);
+			w.Put8(comp_def.second);
+		}
+
+		w.Put8(service.comp_labels.size());
+		for(const comp_labels_t::value_type& comp_label : service.comp_labels) {
+			w.Put8(comp_label.first);
+			w.PutLabel(comp_label.second);
+		}
+
+		w.Put8(service.comp_sls_uas.size());
+		for(const comp_sls_uas_t::value_type& comp_sls_ua : service.comp_sls_uas) {
+			w.Put8(comp_sls_ua.first);
+			w.Put8(comp_sls_ua.second.size());
+			if(!comp_sls_ua.second.empty())
+				w.PutBytes(&comp_sls_ua.second[0], comp_sls_ua.second.size());
+		}
+	}
+
+	// write to a temporary file first, so that the cache file is replaced only as a whole
+	std::string tmp_filename = filename + "." + std::to_string(getpid()) + ".tmp";
+	FILE* cache_file = fopen(tmp_filename.c_str(), "wb");
+	if(!cache_file) {
+		perror("FICDecoder: error while opening cache file for writing");
+		return false;
+	}
+	bool result =
+			fwrite(&w.GetData()[0], w.GetData().size(), 1, cache_file) == 1 &&
+			fflush(cache_file) == 0 &&
+			fsync(fileno(cache_file)) == 0;
+	if(!result)
+		perror("FICDecoder: error while writing cache file");
+	if(fclose(cache_file) && result) {
+		perror("FICDecoder: error while closing cache file");
+		result = false;
+	}
+	if(result && rename(tmp_filename.c_str(), filename.c_str())) {
+		perror("FICDecoder: error while replacing cache file");
+		result = false;
+	}
 
-	// forward to observer
-	observer->FICChangeEnsemble(ensemble);
+	if(!result) {
+		remove(tmp_filename.c_str());
+		return false;
+	}
+
+	fprintf(stderr, "FICDecoder: EId 0x%04X: saved ensemble to cache file '%s'\n", ensemble.eid, filename.c_str());
+	return true;
 }
 
+bool FICDecoder::LoadCache(const std::string& filename) {
+	FILE* cache_file = fopen(filename.c_str(), "rb");
+	if(!cache_file) {
+		// no cache yet is fine
+		if(errno != ENOENT)
+			perror("FICDecoder: error while opening cache file for reading");
+		return false;
+	}
+
+	std::vector<uint8_t> data;
+	uint8_t buffer[4096];
+	size_t len;
+	while((len = fread(buffer, 1, sizeof(buffer), cache_file)) > 0)
+		data.insert(data.end(), buffer, buffer + len);
+	fclose(cache_file);
+
+	FIC_ENSEMBLE new_ensemble;
+	FIC_SUBCHANNEL new_subchannels[64];
+	fic_services_t new_services;
+	try {
+		FICCacheReader r(data);
+
+		uint8_t magic[sizeof(cache_magic)];
+		r.GetBytes(magic, sizeof(magic));
+		if(memcmp(magic, cache_magic, sizeof(magic)) || r.Get8() != cache_version)
+			throw std::runtime_error("unsupported format");
+
+		// ensemble
+		new_ensemble.eid = (uint16_t) r.Get16();
+		r.GetLabel(new_ensemble.label);
+		new_ensemble.ecc = r.Get16();
+		new_ensemble.lto = r.Get16();
+		new_ensemble.inter_table_id = r.Get16();
+
+		// sub-channels
+		for(int subchannel_count = r.Get8(); subchannel_count > 0; subchannel_count--) {
+			FIC_SUBCHANNEL& sc = new_subchannels[r.Get8() & 0x3F];
+			sc.start = r.Get16();
+			sc.size = r.Get16();
+			sc.pl = r.GetString();
+			sc.bitrate = r.Get16();
+			sc.language = r.Get16();
+		}
+
+		// services
+		for(int service_count = (uint16_t) r.Get16(); service_count > 0; service_count--) {
+			new_services.emplace_back();
+			FIC_SERVICE& service = new_services.back();
+
+			service.sid = (uint16_t) r.Get16();
+			service.pri_comp_subchid = r.Get16();
+			r.GetLabel(service.label);
+			service.pty_static = r.Get16();
+			service.asu_flags = r.Get16();
+
+			for(int count = r.Get8(); count > 0; count--)
+				service.cids.insert(r.Get8());
+
+			for(int count = r.Get8(); count > 0; count--) {
+				int subchid = r.Get8() & 0x3F;
+				service.audio_comps[subchid] = AUDIO_SERVICE(subchid, r.Get8());
+			}
+
+			for(int count = r.Get8(); count > 0; count--) {
+				int scids = r.Get8();
+				service.comp_defs[scids] = r.Get8() & 0x3F;
+			}
+
+			for(int count = r.Get8(); count > 0; count--) {
+				int scids = r.Get8();
+				r.GetLabel(service.comp_labels[scids]);
+			}
+
+			for(int count = r.Get8(); count > 0; count--) {
+				ua_data_t& ua_data = service.comp_sls_uas[r.Get8()];
+				ua_data.resize(r.Get8());
+				if(!ua_data.empty())
+					r.GetBytes(&ua_data[0], ua_data.size());
+			}
+
+			// a primary component must always be present
+			if(!service.HasNoPriCompSubchid() && service.audio_comps.find(service.pri_comp_subchid) == service.audio_comps.end())
+				throw std::runtime_error("inconsistent service");
+		}
+	} catch(const std::runtime_error& e) {
+		fprintf(stderr, "FICDecoder: ignoring cache file '%s': %s\n", filename.c_str(), e.what());
+		return false;
+	}
+
+	// apply
+	Reset();
+
+	ensemble = new_ensemble;
+	for(int subchid = 0; subchid < 64; subchid++)
+		subchannels[subchid] = new_subchannels[subchid];
+	for(const FIC_SERVICE& new_service : new_services) {
+		size_t service_index = GetServiceIndex(new_service.sid);
+		services[service_index] = new_service;
+
+		// add reverse references
+		for(const audio_comps_t::value_type& audio_comp : new_service.audio_comps)
+			subchannel_services[audio_comp.first].push_back(service_index);
+		for(const cids_t::value_type& cid : new_service.cids)
+			cluster_services[cid].push_back(service_index);
+
+		UpdateService(services[service_index]);
+	}
+	UpdateEnsemble();
+
+	cache_speculative = true;
+	fprintf(stderr, "FICDecoder: EId 0x%04X: loaded ensemble from cache file '%s' (%zu services)\n", ensemble.eid, filename.c_str(), services.size());
+
+	// list everything right away
+	EmitUpdates();
+	return true;
+}
+
+thread_local fic_labels_utf8_t FICDecoder::labels_utf8;
+const size_t FICDecoder::labels_utf8_max = 1024;
+
 std::string FICDecoder::ConvertLabelToUTF8(const FIC_LABEL& label, std::string* charset_name) {
-	std::string result = CharsetTools::ConvertTextToUTF8(label.label, sizeof(label.label), label.charset, false, charset_name);
+	// labels are converted again and again, so reuse previous results
+	fic_labels_utf8_t::const_iterator it = labels_utf8.find(label);
+	if(it == labels_utf8.cend()) {
+		if(labels_utf8.size() >= labels_utf8_max)
+			labels_utf8.clear();
 
-	// discard trailing spaces
-	size_t last_pos = result.find_last_not_of(' ');
-	if(last_pos != std::string::npos)
-		result.resize(last_pos + 1);
+		FIC_LABEL_UTF8 label_utf8;
+		label_utf8.label = CharsetTools::ConvertTextToUTF8(label.label, sizeof(label.label), label.charset, false, &label_utf8.charset_name);
 
-	return result;
+		// discard trailing spaces
+		size_t last_pos = label_utf8.label.find_last_not_of(' ');
+		if(last_pos != std::string::npos)
+			label_utf8.label.resize(last_pos + 1);
+
+		it = labels_utf8.insert(std::make_pair(label, label_utf8)).first;
+	}
+
+	if(charset_name)
+		*charset_name = it->second.charset_name;
+	return it->second.label;
 }
 
 const size_t FICDecoder::uep_sizes[] = {
@@ -19,11 +19,16 @@
 #ifndef FIC_DECODER_H_
 #define FIC_DECODER_H_
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <unistd.h>
+#include <stdexcept>
 #include <string>
+#include <deque>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <vector>
 #include <math.h>
 #include <time.h>
@@ -66,8 +71,23 @@ struct FIC_LABEL {
 	bool operator!=(const FIC_LABEL & fic_label) const {
 		return !(*this == fic_label);
 	}
+	bool operator<(const FIC_LABEL & fic_label) const {
+		if(charset != fic_label.charset)
+			return charset < fic_label.charset;
+		int cmp = memcmp(label, fic_label.label, sizeof(label));
+		if(cmp)
+			return cmp < 0;
+		return short_label_mask < fic_label.short_label_mask;
+	}
+};
+
+struct FIC_LABEL_UTF8 {
+	std::string label;
+	std::string charset_name;
 };
 
+typedef std::map<FIC_LABEL,FIC_LABEL_UTF8> fic_labels_utf8_t;
+
 struct FIC_SUBCHANNEL {
 	size_t start;
 	size_t size;
@@ -214,7 +234,9 @@ struct FIC_SERVICE {
 
 	static const int asu_flags_none = 0x0000;
 
-	FIC_SERVICE() : sid(sid_none), pri_comp_subchid(pri_comp_subchid_none), pty_static(pty_none), pty_dynamic(pty_none), asu_flags(asu_flags_none) {}
+	bool update_pending;
+
+	FIC_SERVICE() : sid(sid_none), pri_comp_subchid(pri_comp_subchid_none), pty_static(pty_none), pty_dynamic(pty_none), asu_flags(asu_flags_none), update_pending(false) {}
 };
 
 struct LISTED_SERVICE {
@@ -256,6 +278,25 @@ struct LISTED_SERVICE {
 		multi_comps(false)
 	{}
 
+	bool operator==(const LISTED_SERVICE & service) const {
+		return
+				sid == service.sid &&
+				scids == service.scids &&
+				subchannel == service.subchannel &&
+				audio_service == service.audio_service &&
+				label == service.label &&
+				pty_static == service.pty_static &&
+				pty_dynamic == service.pty_dynamic &&
+				sls_app_type == service.sls_app_type &&
+				asu_flags == service.asu_flags &&
+				cids == service.cids &&
+				pri_comp_subchid == service.pri_comp_subchid &&
+				multi_comps == service.multi_comps;
+	}
+	bool operator!=(const LISTED_SERVICE & service) const {
+		return !(*this == service);
+	}
+
 	bool operator<(const LISTED_SERVICE & service) const {
 		if(pri_comp_subchid != service.pri_comp_subchid)
 			return pri_comp_subchid < service.pri_comp_subchid;
@@ -265,8 +306,88 @@ struct LISTED_SERVICE {
 	}
 };
 
-typedef std::map<uint16_t, FIC_SERVICE> fic_services_t;
-typedef std::map<int, FIC_SUBCHANNEL> fic_subchannels_t;
+struct FIC_FIG_STATS {
+	size_t count;				// incl. FIGs skipped as identical to recently processed ones
+	size_t last_seen_ms;
+	size_t repeats;
+	size_t repetition_ms_sum;
+	size_t repetition_ms_max;	// longest time until identical content was repeated (since start)
+	std::deque<size_t> recent_repetitions_ms;
+
+	FIC_FIG_STATS() : count(0), last_seen_ms(0), repeats(0), repetition_ms_sum(0), repetition_ms_max(0) {}
+
+	void AddRepetition(size_t repetition_ms);
+	bool IsRepeated() const {return repeats;}
+	size_t GetMeanRepetitionMs() const {return repeats ? repetition_ms_sum / repeats : 0;}
+	size_t GetRecentRepetitionMs() const;	// longest of the recent repetition times i.e. current carousel cycle
+
+	static const size_t recent_repetitions_count;
+};
+
+typedef std::map<std::pair<int,int>,FIC_FIG_STATS> fig_stats_t;	// (type, extension) -> FIC_FIG_STATS
+
+struct FIC_FIG_CACHE_ENTRY {
+	uint64_t hash;			// content last seen
+	size_t generation;		// of the FIG type/extension, when last processed
+};
+
+typedef std::unordered_map<uint32_t,FIC_FIG_CACHE_ENTRY> fig_cache_t;	// FIG header + first entity -> FIC_FIG_CACHE_ENTRY
+typedef std::map<int,size_t> fig_cache_generations_t;					// FIG type/extension -> content generation
+typedef std::unordered_map<uint64_t,size_t> fig_instances_t;		// FIG content hash -> last seen
+
+struct FIC_COMPLETENESS {
+	bool complete;				// all announced services resolved and no change for a full carousel cycle
+	double confidence;			// 0.0 ... 1.0
+	size_t services;			// announced programme services (having an audio component)
+	size_t services_resolved;	// of which primary component and label are present (sub-channel details are not signalled by every ensemble)
+	size_t carousel_ms;			// longest recent repetition time of the FIGs needed for the service list
+	size_t elapsed_ms;			// FIC time since start
+
+	FIC_COMPLETENESS() : complete(false), confidence(0.0), services(0), services_resolved(0), carousel_ms(0), elapsed_ms(0) {}
+};
+
+typedef std::vector<LISTED_SERVICE> listed_services_t;
+typedef std::map<std::pair<int,int>,LISTED_SERVICE> emitted_listed_services_t;	// (SId, SCIdS) -> LISTED_SERVICE
+
+typedef std::vector<FIC_SERVICE> fic_services_t;
+typedef std::unordered_map<uint16_t, size_t> fic_service_indices_t;	// SId -> index in fic_services_t
+typedef std::vector<size_t> fic_service_refs_t;							// indices in fic_services_t
+
+// --- FICCacheWriter -----------------------------------------------------------------
+class FICCacheWriter {
+private:
+	std::vector<uint8_t> data;
+public:
+	const std::vector<uint8_t>& GetData() const {return data;}
+
+	void Put8(int value) {data.push_back(value);}
+	void Put16(int value) {Put8(value >> 8); Put8(value);}
+	void PutBytes(const uint8_t *bytes, size_t len) {data.insert(data.end(), bytes, bytes + len);}
+	void PutString(const std::string& value) {Put8(value.length()); PutBytes((const uint8_t*) value.c_str(), value.length());}
+	void PutLabel(const FIC_LABEL& label) {Put16(label.charset); PutBytes(label.label, sizeof(label.label)); Put16(label.short_label_mask);}
+};
+
+
+// --- FICCacheReader -----------------------------------------------------------------
+class FICCacheReader {
+private:
+	const std::vector<uint8_t>& data;
+	size_t offset;
+
+	void Require(size_t len) {
+		if(offset + len > data.size())
+			throw std::runtime_error("truncated data");
+	}
+public:
+	FICCacheReader(const std::vector<uint8_t>& data) : data(data), offset(0) {}
+
+	int Get8() {Require(1); return data[offset++];}
+	int Get16() {int hi = Get8(); return (int16_t) (hi << 8 | Get8());}	// signed
+	void GetBytes(uint8_t *bytes, size_t len) {Require(len); memcpy(bytes, &data[offset], len); offset += len;}
+	std::string GetString() {size_t len = Get8(); Require(len); std::string result((const char*) &data[offset], len); offset += len; return result;}
+	void GetLabel(FIC_LABEL& label) {label.charset = Get16(); GetBytes(label.label, sizeof(label.label)); label.short_label_mask = Get16();}
+};
+
 
 // --- FICDecoderObserver -----------------------------------------------------------------
 class FICDecoderObserver {
@@ -274,8 +395,16 @@ public:
 	virtual ~FICDecoderObserver() {}
 
 	virtual void FICChangeEnsemble(const FIC_ENSEMBLE& /*ensemble*/) {}
-	virtual void FICChangeService(const LISTED_SERVICE& /*service*/) {}
+	virtual void FICResetEnsemble() {}	// the speculatively used cached ensemble was contradicted; all its services are gone
+	virtual void FICChangeService(const LISTED_SERVICE& /*service*/) {}	// label may not yet be present
+
+	// all services changed within one processed FIC data block; by default forwarded one by one
+	virtual void FICChangeServices(const listed_services_t& services, unsigned int /*version*/) {
+		for(const LISTED_SERVICE& service : services)
+			FICChangeService(service);
+	}
 	virtual void FICChangeUTCDateTime(const FIC_DAB_DT& /*utc_dt*/) {}
+	virtual void FICChangeCompleteness(const FIC_COMPLETENESS& /*completeness*/) {}	// whenever the ensemble becomes (in)complete
 
 	virtual void FICDiscardedFIB() {}
 };
@@ -289,6 +418,27 @@ private:
 
 	void ProcessFIB(const uint8_t *data);
 
+	fig_cache_t fig_cache;
+	fig_cache_generations_t fig_cache_generations;
+	size_t fig_cache_lookups;
+	size_t fig_cache_hits;
+	static uint64_t HashFIG(const uint8_t *data, size_t len);
+	bool IsFIGCacheable(const uint8_t *data, size_t len);
+	bool CheckFIGCache(const uint8_t *data, size_t len, uint64_t hash);
+	void ClearFIGCache();
+
+	// FIC time (never reset); advanced per processed (24 ms) ETI/EDI frame
+	size_t fic_time_ms;
+	size_t last_change_ms;
+	size_t last_error_ms;	// repetitions spanning a discarded FIB are not counted, as an instance may have been missed
+
+	fig_stats_t fig_stats;
+	fig_instances_t fig_instances;
+	void UpdateFIGStats(const uint8_t *data, size_t len, uint64_t hash, bool time_varying);
+
+	FIC_COMPLETENESS completeness;
+	void UpdateCompleteness();
+
 	void ProcessFIG0(const uint8_t *data, size_t len);
 	void ProcessFIG0_0(const uint8_t *data, size_t len);
 	void ProcessFIG0_1(const uint8_t *data, size_t len);
@@ -309,20 +459,38 @@ private:
 
 	FIC_SUBCHANNEL& GetSubchannel(int subchid);
 	void UpdateSubchannel(int subchid);
-	FIC_SERVICE& GetService(uint16_t sid);
+	size_t GetServiceIndex(uint16_t sid);
+	FIC_SERVICE& GetService(uint16_t sid) {return services[GetServiceIndex(sid)];}
 	void UpdateService(const FIC_SERVICE& service);
+	void ListService(const FIC_SERVICE& service);
 	void UpdateListedService(const FIC_SERVICE& service, int scids, bool multi_comps);
 	int GetSLSAppType(const ua_data_t& ua_data);
 
 	FIC_ENSEMBLE ensemble;
 	void UpdateEnsemble();
 
-	fic_services_t services;
-	fic_subchannels_t subchannels;	// from FIG 0/1: SubChId -> FIC_SUBCHANNEL
+	// updates are collected while processing and emitted afterwards - if anything actually changed
+	bool ensemble_update_pending;
+	fic_service_refs_t pending_services;
+	FIC_ENSEMBLE emitted_ensemble;
+	emitted_listed_services_t emitted_listed_services;
+	listed_services_t changed_listed_services;
+	unsigned int services_version;
+	void EmitUpdates();
+
+	fic_services_t services;						// in order of appearance
+	fic_service_indices_t service_indices;
+	FIC_SUBCHANNEL subchannels[64];					// from FIG 0/1: SubChId -> FIC_SUBCHANNEL
+	fic_service_refs_t subchannel_services[64];		// SubChId -> services having an audio component on it
+	fic_service_refs_t cluster_services[256];		// CId -> services supporting the announcement cluster
 
 	FIC_DAB_DT utc_dt;
 	bool utc_dt_long;
 
+	bool cache_speculative;		// state loaded from cache, not yet confirmed by live FIGs
+	static const uint8_t cache_magic[];
+	static const int cache_version;
+
 	static const size_t uep_sizes[];
 	static const int uep_pls[];
 	static const int uep_bitrates[];
@@ -336,15 +504,36 @@ private:
 	static const char* ptys_rbds_0x00_to_0x1D[];
 
 	static const char* asu_types_0_to_10[];
+
+	static thread_local fic_labels_utf8_t labels_utf8;	// conversion cache
+	static const size_t labels_utf8_max;
 public:
 	FICDecoder(FICDecoderObserver *observer, bool disable_dyn_msgs) :
 		observer(observer),
 		disable_dyn_msgs(disable_dyn_msgs),
-		utc_dt_long(false)
-	{}
+		fig_cache_lookups(0),
+		fig_cache_hits(0),
+		fic_time_ms(0),
+		last_change_ms(0),
+		last_error_ms(0),
+		ensemble_update_pending(false),
+		services_version(0),
+		utc_dt_long(false),
+		cache_speculative(false)
+	{
+		ClearFIGCache();
+	}
+	~FICDecoder();
 
 	void Process(const uint8_t *data, size_t len);
 	void Reset();
+	void GetFIGCacheStats(size_t& lookups, size_t& hits) const {lookups = fig_cache_lookups; hits = fig_cache_hits;}
+	const fig_stats_t& GetFIGStats() const {return fig_stats;}
+	const FIC_COMPLETENESS& GetCompleteness() const {return completeness;}
+
+	bool LoadCache(const std::string& filename);
+	bool SaveCache(const std::string& filename);
+	static std::string GetCacheFilename(const std::string& cache_dir, const std::string& channel) {return cache_dir + "/" + channel + ".fic";}
 
 	static std::string ConvertLabelToUTF8(const FIC_LABEL& label, std::string* charset_name);
 	static std::string ConvertLanguageToString(const int value);
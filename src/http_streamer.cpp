@@ -0,0 +1,500 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "http_streamer.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+
+#include "version.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0	// SO_NOSIGPIPE is used instead
+#endif
+
+
+// --- HTTPStream -----------------------------------------------------------------
+std::string HTTPStream::GetContentType(const std::string& file_extension) {
+	if(file_extension == "mp2")
+		return "audio/mpeg";
+	if(file_extension == "aac")
+		return "audio/mp4a-latm";	// LATM/LOAS, not ADTS (as "audio/aac" would imply)
+	return "";
+}
+
+void HTTPStream::ProcessUntouchedStream(const uint8_t* data, size_t len, size_t duration_ms) {
+	UNTOUCHED_STREAM_PART part = {data, len};
+	ProcessUntouchedStreamParts(&part, 1, duration_ms);
+}
+
+void HTTPStream::ProcessUntouchedStreamParts(const UNTOUCHED_STREAM_PART* parts, size_t count, size_t /*duration_ms*/) {
+	// avoid any effort without clients
+	if(!streaming_clients)
+		return;
+
+	// join the parts once; the resulting buffer is shared by all clients
+	std::shared_ptr<std::vector<uint8_t>> buffer = std::make_shared<std::vector<uint8_t>>();
+	for(size_t i = 0; i < count; i++)
+		buffer->insert(buffer->end(), parts[i].data, parts[i].data + parts[i].len);
+
+	bool wakeup;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		wakeup = pending.empty();
+		pending.push_back(buffer);
+	}
+	if(wakeup)
+		streamer->Wakeup();
+}
+
+void HTTPStream::UntouchedStreamChangeFormat(const std::string& file_extension) {
+	std::string new_content_type = GetContentType(file_extension);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		// a service of the same format can be continued seamlessly
+		if(new_content_type == content_type)
+			return;
+		content_type = new_content_type;
+		format_changed = true;
+		pending.clear();
+	}
+	streamer->Wakeup();
+}
+
+void HTTPStream::FetchPending(std::deque<http_stream_buffer_t>& buffers, bool& new_format) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	buffers.swap(pending);
+	new_format = format_changed;
+	format_changed = false;
+}
+
+std::string HTTPStream::GetContentType() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return content_type;
+}
+
+
+// --- HTTPStreamer -----------------------------------------------------------------
+const std::string HTTPStreamer::default_address = "127.0.0.1";
+const size_t HTTPStreamer::max_client_queue_bytes = 128 * 1024;	// about 5s at 192 kbit/s
+const size_t HTTPStreamer::max_request_len = 8192;
+const size_t HTTPStreamer::max_iov_count = 64;
+const std::chrono::milliseconds HTTPStreamer::request_timeout = std::chrono::milliseconds(10000);
+
+static void SetNonBlocking(int fd) {
+	int flags = fcntl(fd, F_GETFL);
+	if(flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK))
+		throw std::runtime_error("HTTPStreamer: error while setting non-blocking mode: " + std::string(strerror(errno)));
+}
+
+HTTPStreamer::HTTPStreamer(const std::string& address, int port) {
+	do_exit = false;
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if(inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+		throw std::runtime_error("HTTPStreamer: invalid address '" + address + "'");
+
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	if(listen_fd == -1)
+		throw std::runtime_error("HTTPStreamer: error while creating socket: " + std::string(strerror(errno)));
+
+	int reuse = 1;
+	if(setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)))
+		perror("HTTPStreamer: error while setting SO_REUSEADDR");
+
+	if(bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr)) || listen(listen_fd, SOMAXCONN)) {
+		std::string error = strerror(errno);
+		close(listen_fd);
+		throw std::runtime_error("HTTPStreamer: error while listening on " + address + ":" + std::to_string(port) + ": " + error);
+	}
+	SetNonBlocking(listen_fd);
+
+	if(pipe(wakeup_fds))
+		throw std::runtime_error("HTTPStreamer: error while creating wakeup pipe: " + std::string(strerror(errno)));
+	SetNonBlocking(wakeup_fds[0]);
+	SetNonBlocking(wakeup_fds[1]);
+
+	fprintf(stderr, "HTTPStreamer: listening on http://%s:%d/\n", address.c_str(), port);
+
+	thread = std::thread(&HTTPStreamer::EventLoop, this);
+}
+
+HTTPStreamer::~HTTPStreamer() {
+	do_exit = true;
+	Wakeup();
+	thread.join();
+
+	for(HTTP_STREAMER_CLIENT* client : clients) {
+		CloseClient(client, "shutdown");
+		delete client;
+	}
+	for(auto& stream : streams)
+		delete stream.second;
+
+	close(wakeup_fds[0]);
+	close(wakeup_fds[1]);
+	close(listen_fd);
+}
+
+HTTPStream* HTTPStreamer::AddStream(const std::string& path) {
+	std::lock_guard<std::mutex> lock(streams_mutex);
+
+	HTTPStream*& stream = streams[path];
+	if(!stream)
+		stream = new HTTPStream(this);
+	return stream;
+}
+
+bool HTTPStreamer::ParseBindAddress(const std::string& spec, std::string& address, int& port) {
+	// [<address>:]<port>
+	size_t sep = spec.rfind(':');
+	std::string port_str = sep == std::string::npos ? spec : spec.substr(sep + 1);
+	address = sep == std::string::npos ? default_address : spec.substr(0, sep);
+
+	if(address.empty() || port_str.empty())
+		return false;
+
+	char* endptr;
+	long value = strtol(port_str.c_str(), &endptr, 10);
+	if(*endptr || value < 1 || value > 65535)
+		return false;
+	port = value;
+	return true;
+}
+
+void HTTPStreamer::Wakeup() {
+	// a full pipe already ensures a wakeup
+	uint8_t dummy = 0;
+	if(write(wakeup_fds[1], &dummy, 1) == -1 && errno != EAGAIN && errno != EWOULDBLOCK)
+		perror("HTTPStreamer: error while writing to wakeup pipe");
+}
+
+int HTTPStreamer::GetPollTimeout() {
+	// wait until the next incomplete request expires, if any
+	int timeout = -1;
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	for(HTTP_STREAMER_CLIENT* client : clients) {
+		if(client->stream)
+			continue;
+
+		long remaining = std::chrono::duration_cast<std::chrono::milliseconds>(client->connect_time + request_timeout - now).count();
+		int client_timeout = std::max(remaining + 1, 0L);	// round up
+		if(timeout == -1 || client_timeout < timeout)
+			timeout = client_timeout;
+	}
+	return timeout;
+}
+
+void HTTPStreamer::EventLoop() {
+	std::vector<struct pollfd> pfds;
+
+	while(!do_exit) {
+		pfds.resize(2 + clients.size());
+		pfds[0] = {wakeup_fds[0], POLLIN, 0};
+		pfds[1] = {listen_fd, POLLIN, 0};
+		for(size_t i = 0; i < clients.size(); i++) {
+			// POLLIN also serves to detect a closed connection while streaming
+			short events = POLLIN;
+			if(!clients[i]->queue.empty())
+				events |= POLLOUT;
+			pfds[2 + i] = {clients[i]->fd, events, 0};
+		}
+
+		if(poll(&pfds[0], pfds.size(), GetPollTimeout()) == -1) {
+			if(errno == EINTR)
+				continue;
+			perror("HTTPStreamer: error while poll");
+			break;
+		}
+
+		// fetch new buffers and format changes of all streams
+		http_stream_updates_t updates;
+		if(pfds[0].revents) {
+			uint8_t dummy[64];
+			while(read(wakeup_fds[0], dummy, sizeof(dummy)) > 0);
+
+			std::lock_guard<std::mutex> lock(streams_mutex);
+			for(auto& stream : streams) {
+				HTTP_STREAM_UPDATE& update = updates[stream.second];
+				stream.second->FetchPending(update.buffers, update.new_format);
+			}
+		}
+
+		// handle the clients known before this iteration (new clients are appended later)
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		std::vector<HTTP_STREAMER_CLIENT*> closed_clients;
+		for(size_t i = 0; i < pfds.size() - 2; i++) {
+			HTTP_STREAMER_CLIENT* client = clients[i];
+			short revents = pfds[2 + i].revents;
+
+			// only streaming clients are affected by updates
+			http_stream_updates_t::const_iterator update_it = client->stream ? updates.find(client->stream) : updates.cend();
+			const HTTP_STREAM_UPDATE* update = update_it != updates.cend() ? &update_it->second : nullptr;
+
+			if(update && update->new_format) {
+				CloseClient(client, "stream format changed");
+				closed_clients.push_back(client);
+				continue;
+			}
+
+			if(revents & (POLLIN | POLLERR | POLLHUP)) {
+				if(!ReadRequest(client)) {
+					closed_clients.push_back(client);
+					continue;
+				}
+			}
+
+			// don't let clients occupy a connection without ever completing their request
+			if(!client->stream && now - client->connect_time >= request_timeout) {
+				CloseClient(client, "request timeout");
+				closed_clients.push_back(client);
+				continue;
+			}
+
+			if(update) {
+				bool ok = true;
+				for(const http_stream_buffer_t& buffer : update->buffers) {
+					if(!QueueBuffer(client, buffer)) {
+						ok = false;
+						break;
+					}
+				}
+				if(!ok) {
+					closed_clients.push_back(client);
+					continue;
+				}
+			}
+
+			// write immediately, instead of waiting for the next poll
+			if(!client->queue.empty() && !WriteQueue(client))
+				closed_clients.push_back(client);
+		}
+		for(HTTP_STREAMER_CLIENT* client : closed_clients) {
+			for(auto it = clients.begin(); it != clients.end(); it++) {
+				if(*it == client) {
+					clients.erase(it);
+					break;
+				}
+			}
+			delete client;
+		}
+
+		if(pfds[1].revents & POLLIN)
+			AcceptClients();
+	}
+}
+
+void HTTPStreamer::AcceptClients() {
+	for(;;) {
+		struct sockaddr_in addr;
+		socklen_t addr_len = sizeof(addr);
+		int fd = accept(listen_fd, (struct sockaddr*) &addr, &addr_len);
+		if(fd == -1) {
+			if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				perror("HTTPStreamer: error while accept");
+			return;
+		}
+
+		try {
+			SetNonBlocking(fd);
+		} catch(const std::runtime_error& e) {
+			fprintf(stderr, "%s\n", e.what());
+			close(fd);
+			continue;
+		}
+#ifdef SO_NOSIGPIPE
+		int nosigpipe = 1;
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &nosigpipe, sizeof(nosigpipe));
+#endif
+
+		char ip[INET_ADDRSTRLEN];
+		inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+		clients.push_back(new HTTP_STREAMER_CLIENT(fd, std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port))));
+	}
+}
+
+bool HTTPStreamer::ReadRequest(HTTP_STREAMER_CLIENT* client) {
+	char buffer[1024];
+	for(;;) {
+		ssize_t len = recv(client->fd, buffer, sizeof(buffer), 0);
+		if(len == 0) {
+			CloseClient(client, "disconnected");
+			return false;
+		}
+		if(len == -1) {
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			if(errno == EINTR)
+				continue;
+			CloseClient(client, strerror(errno));
+			return false;
+		}
+
+		// anything sent while streaming is ignored
+		if(!client->stream)
+			client->request.append(buffer, len);
+	}
+
+	if(client->stream)
+		return true;
+
+	size_t header_end = client->request.find("\r\n\r\n");
+	if(header_end == std::string::npos) {
+		if(client->request.size() > max_request_len) {
+			CloseClient(client, "request too long");
+			return false;
+		}
+		return true;
+	}
+
+	// request line: <method> <path>[?<query>] <version>
+	size_t method_end = client->request.find(' ');
+	size_t path_end = method_end == std::string::npos ? std::string::npos : client->request.find_first_of(" ?\r", method_end + 1);
+	std::string method = client->request.substr(0, method_end);
+	std::string path = path_end == std::string::npos ? "" : client->request.substr(method_end + 1, path_end - method_end - 1);
+
+	// the service paths consist of hex digits only
+	for(char& c : path)
+		c = toupper(c);
+
+	HTTPStream *stream = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(streams_mutex);
+		http_streams_t::const_iterator it = streams.find(path);
+		if(it != streams.cend())
+			stream = it->second;
+	}
+	std::string content_type = stream ? stream->GetContentType() : "";
+
+	std::string status;
+	if(method != "GET" && method != "HEAD")
+		status = "405 Method Not Allowed";
+	else if(!stream)
+		status = "404 Not Found";
+	else if(content_type.empty())
+		status = "503 Service Unavailable";
+	else
+		status = "200 OK";
+
+	std::string header = "HTTP/1.0 " + status + "\r\n";
+	if(status == "200 OK")
+		header += "Content-Type: " + content_type + "\r\nCache-Control: no-cache, no-store\r\n";
+	header += "Connection: close\r\nServer: DABlin/" DABLIN_VERSION "\r\n\r\n";
+
+	if(status != "200 OK" || method == "HEAD") {
+		// best effort, as the header fits into any socket buffer
+		if(send(client->fd, header.c_str(), header.size(), MSG_NOSIGNAL) == -1)
+			perror("HTTPStreamer: error while sending response");
+		CloseClient(client, status == "200 OK" ? "HEAD request" : status.c_str());
+		return false;
+	}
+
+	client->request.clear();
+	client->request.shrink_to_fit();
+	client->stream = stream;
+	size_t stream_clients = stream->AddClient();
+	fprintf(stderr, "HTTPStreamer: client %s connected to %s (%zu clients)\n", client->address.c_str(), path.c_str(), stream_clients);
+
+	// the response header is queued like any other buffer
+	return QueueBuffer(client, std::make_shared<std::vector<uint8_t>>(header.begin(), header.end()));
+}
+
+bool HTTPStreamer::QueueBuffer(HTTP_STREAMER_CLIENT* client, const http_stream_buffer_t& buffer) {
+	// never stall the decoder (or other clients) due to a slow client
+	if(client->queue_bytes + buffer->size() > max_client_queue_bytes) {
+		CloseClient(client, "too slow");
+		return false;
+	}
+
+	client->queue.push_back(buffer);
+	client->queue_bytes += buffer->size();
+	return true;
+}
+
+bool HTTPStreamer::WriteQueue(HTTP_STREAMER_CLIENT* client) {
+	struct iovec iov[max_iov_count];
+
+	while(!client->queue.empty()) {
+		// gather as many buffers as possible into a single call
+		size_t iov_count = 0;
+		for(auto it = client->queue.cbegin(); it != client->queue.cend() && iov_count < max_iov_count; it++, iov_count++) {
+			size_t offset = iov_count == 0 ? client->queue_offset : 0;
+			iov[iov_count].iov_base = (void*) ((*it)->data() + offset);
+			iov[iov_count].iov_len = (*it)->size() - offset;
+		}
+
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = iov_count;
+
+		ssize_t len = sendmsg(client->fd, &msg, MSG_NOSIGNAL);
+		if(len == -1) {
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				return true;
+			if(errno == EINTR)
+				continue;
+			CloseClient(client, strerror(errno));
+			return false;
+		}
+		client->sent_bytes += len;
+		client->queue_bytes -= len;
+
+		// release the completely sent buffers
+		size_t remaining = len;
+		while(remaining) {
+			size_t buffer_remaining = client->queue.front()->size() - client->queue_offset;
+			if(remaining < buffer_remaining) {
+				client->queue_offset += remaining;
+				break;
+			}
+			remaining -= buffer_remaining;
+			client->queue.pop_front();
+			client->queue_offset = 0;
+		}
+	}
+	return true;
+}
+
+void HTTPStreamer::CloseClient(HTTP_STREAMER_CLIENT* client, const char* reason) {
+	if(client->stream) {
+		client->stream->RemoveClient();
+		fprintf(stderr, "HTTPStreamer: client %s closed: %s (%zu bytes sent)\n", client->address.c_str(), reason, client->sent_bytes);
+	}
+	close(client->fd);
+	client->fd = -1;
+	client->stream = nullptr;
+	client->queue.clear();
+	client->queue_bytes = 0;
+	client->queue_offset = 0;
+}
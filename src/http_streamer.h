@@ -0,0 +1,140 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HTTP_STREAMER_H_
+#define HTTP_STREAMER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "subchannel_sink.h"
+
+
+typedef std::shared_ptr<const std::vector<uint8_t>> http_stream_buffer_t;
+
+
+class HTTPStreamer;
+
+// --- HTTPStream -----------------------------------------------------------------
+// a single untouched stream (e.g. of the current or a certain service), served at its own path
+class HTTPStream : public UntouchedStreamConsumer {
+private:
+	HTTPStreamer *streamer;
+	std::atomic<size_t> streaming_clients;	// maintained by the event loop
+
+	// guarded by mutex
+	std::mutex mutex;
+	std::deque<http_stream_buffer_t> pending;
+	std::string content_type;
+	bool format_changed;
+
+	static std::string GetContentType(const std::string& file_extension);
+public:
+	HTTPStream(HTTPStreamer *streamer) : streamer(streamer), streaming_clients(0), format_changed(false) {}
+
+	void ProcessUntouchedStream(const uint8_t* data, size_t len, size_t duration_ms);
+	void ProcessUntouchedStreamParts(const UNTOUCHED_STREAM_PART* parts, size_t count, size_t duration_ms);
+	void UntouchedStreamChangeFormat(const std::string& file_extension);
+
+	bool HasClients() {return streaming_clients;}
+
+	// only used by the event loop
+	void FetchPending(std::deque<http_stream_buffer_t>& buffers, bool& new_format);
+	std::string GetContentType();
+	size_t AddClient() {return ++streaming_clients;}
+	void RemoveClient() {streaming_clients--;}
+};
+
+
+// --- HTTP_STREAMER_CLIENT -----------------------------------------------------------------
+struct HTTP_STREAMER_CLIENT {
+	int fd;
+	std::string address;
+	std::string request;	// until the request header is complete
+	std::chrono::steady_clock::time_point connect_time;
+	HTTPStream *stream;		// if streaming
+
+	std::deque<http_stream_buffer_t> queue;	// buffers shared by all clients
+	size_t queue_offset;	// already sent bytes of the first buffer
+	size_t queue_bytes;
+	size_t sent_bytes;
+
+	HTTP_STREAMER_CLIENT(int fd, const std::string& address) : fd(fd), address(address), connect_time(std::chrono::steady_clock::now()), stream(nullptr), queue_offset(0), queue_bytes(0), sent_bytes(0) {}
+};
+
+
+// --- HTTP_STREAM_UPDATE -----------------------------------------------------------------
+struct HTTP_STREAM_UPDATE {
+	std::deque<http_stream_buffer_t> buffers;
+	bool new_format;
+
+	HTTP_STREAM_UPDATE() : new_format(false) {}
+};
+
+typedef std::map<std::string, HTTPStream*> http_streams_t;	// by path
+typedef std::map<HTTPStream*, HTTP_STREAM_UPDATE> http_stream_updates_t;
+
+
+// --- HTTPStreamer -----------------------------------------------------------------
+// serves untouched streams to HTTP clients, from its own event loop thread
+class HTTPStreamer {
+private:
+	int listen_fd;
+	int wakeup_fds[2];
+
+	std::thread thread;
+	std::atomic<bool> do_exit;
+
+	std::mutex streams_mutex;
+	http_streams_t streams;		// never removed
+
+	std::vector<HTTP_STREAMER_CLIENT*> clients;	// only used by the event loop
+
+	void EventLoop();
+	int GetPollTimeout();
+	void AcceptClients();
+	bool ReadRequest(HTTP_STREAMER_CLIENT* client);
+	bool WriteQueue(HTTP_STREAMER_CLIENT* client);
+	bool QueueBuffer(HTTP_STREAMER_CLIENT* client, const http_stream_buffer_t& buffer);
+	void CloseClient(HTTP_STREAMER_CLIENT* client, const char* reason);
+public:
+	HTTPStreamer(const std::string& address, int port);
+	~HTTPStreamer();
+
+	HTTPStream* AddStream(const std::string& path);	// if already present, the existing stream
+	void Wakeup();
+
+	static bool ParseBindAddress(const std::string& spec, std::string& address, int& port);
+
+	static const std::string default_address;
+	static const size_t max_client_queue_bytes;
+	static const size_t max_request_len;
+	static const size_t max_iov_count;
+	static const std::chrono::milliseconds request_timeout;
+};
+
+#endif /* HTTP_STREAMER_H_ */
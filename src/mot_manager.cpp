@@ -20,41 +20,79 @@
 
 
 // --- MOTEntity -----------------------------------------------------------------
-void MOTEntity::AddSeg(int seg_number, bool last_seg, const uint8_t* data, size_t len) {
-	if(last_seg)
-		last_seg_number = seg_number;
+const size_t MOTEntity::max_reserve_size = 1024 * 1024;
+const size_t MOTEntity::max_unannounced_size = 1024 * 1024;
 
-	if(segs.find(seg_number) != segs.end())
-		return;
+void MOTEntity::SetAnnouncedSize(size_t total_size) {
+	max_size = total_size;
 
-	// copy data
-	segs[seg_number] = seg_t(len);
-	memcpy(&segs[seg_number][0], data, len);
-	size += len;
+	// if already received segments exceed the announced size, start over
+	if(data.size() > max_size)
+		Reset();
+
+	// the size is announced in advance, but don't trust it blindly
+	data.reserve(std::min(total_size, max_reserve_size));
 }
 
-bool MOTEntity::IsFinished() {
-	if(last_seg_number == -1)
-		return false;
+void MOTEntity::AddSeg(int seg_number, bool last_seg, const uint8_t* seg_data, size_t len) {
+	// ignore segments beyond the last one
+	if(last_seg_number != -1 && seg_number > last_seg_number)
+		return;
 
-	// check if all segments are available
-	for(int i = 0; i <= last_seg_number; i++)
-		if(segs.find(i) == segs.end())
-			return false;
-	return true;
-}
+	// ignore already received segments
+	if((size_t) seg_number < segs_received.size() && segs_received[seg_number])
+		return;
+	if(last_seg && !pending_last_seg.empty())
+		return;
 
-std::vector<uint8_t> MOTEntity::GetData() {
-	std::vector<uint8_t> result(size);
-	size_t offset = 0;
+	if(last_seg) {
+		if(seg_number != 0 && seg_size == 0) {
+			// offset not yet known
+			pending_last_seg.assign(seg_data, seg_data + len);
+			last_seg_number = seg_number;
+			return;
+		}
+		last_seg_number = seg_number;
+		PutSeg(seg_number, seg_number * seg_size, seg_data, len);
+		return;
+	}
+
+	// if the segment size is inconsistent, start over
+	if(seg_size != 0 && seg_size != len)
+		Reset();
 
-	// concatenate all segments
-	for(int i = 0; i <= last_seg_number; i++) {
-		seg_t& seg = segs[i];
-		memcpy(&result[offset], &seg[0], seg.size());
-		offset += seg.size();
+	if(seg_size == 0) {
+		seg_size = len;
+
+		// the offset of an already received last segment is now known
+		if(!pending_last_seg.empty()) {
+			PutSeg(last_seg_number, last_seg_number * seg_size, &pending_last_seg[0], pending_last_seg.size());
+			pending_last_seg.clear();
+		}
 	}
+	PutSeg(seg_number, seg_number * seg_size, seg_data, len);
+}
+
+void MOTEntity::PutSeg(int seg_number, size_t offset, const uint8_t* seg_data, size_t len) {
+	// ignore segments beyond the (announced) size, as the offset is only limited by the segment number
+	if(offset + len > max_size)
+		return;
 
+	if(data.size() < offset + len)
+		data.resize(offset + len);
+	memcpy(&data[offset], seg_data, len);
+
+	if(segs_received.size() <= (size_t) seg_number)
+		segs_received.resize(seg_number + 1);
+	segs_received[seg_number] = true;
+	segs_count++;
+	size += len;
+}
+
+mot_data_t MOTEntity::TakeData() {
+	mot_data_t result;
+	result.swap(data);
+	Reset();
 	return result;
 }
 
@@ -64,12 +102,17 @@ void MOTObject::AddSeg(bool dg_type_header, int seg_number, bool last_seg, const
 	(dg_type_header ? header : body).AddSeg(seg_number, last_seg, data, len);
 }
 
-bool MOTObject::ParseCheckHeader(MOT_FILE& target_file) {
+void MOTObject::SetDirectoryHeader(const uint8_t* data, size_t len) {
+	// as the directory is repeated, the header is processed only once
+	if(ParseCheckHeader(data, len, result_file, true))
+		body.SetAnnouncedSize(result_file.body_size);
+}
+
+bool MOTObject::ParseCheckHeader(const uint8_t* data, size_t len, MOT_FILE& target_file, bool directory_mode) {
 	MOT_FILE file = target_file;
-	std::vector<uint8_t> data = header.GetData();
 
 	// parse/check header core
-	if(data.size() < 7)
+	if(len < 7)
 		return false;
 
 	size_t body_size = (data[0] << 20) | (data[1] << 12) | (data[2] << 4) | (data[3] >> 4);
@@ -80,10 +123,12 @@ bool MOTObject::ParseCheckHeader(MOT_FILE& target_file) {
 //	fprintf(stderr, "body_size: %5zu, header_size: %3zu, content_type: 0x%02X, content_sub_type: 0x%03X\n",
 //			body_size, header_size, content_type, content_sub_type);
 
-	if(header_size != header.GetSize())
+	if(header_size != len)
 		return false;
 
+	// no header updates in directory mode
 	bool header_update =
+			!directory_mode &&
 			content_type == MOT_FILE::CONTENT_TYPE_MOT_TRANSPORT &&
 			content_sub_type == MOT_FILE::CONTENT_SUB_TYPE_HEADER_UPDATE;
 
@@ -96,13 +141,17 @@ bool MOTObject::ParseCheckHeader(MOT_FILE& target_file) {
 		file.body_size = body_size;
 		file.content_type = content_type;
 		file.content_sub_type = content_sub_type;
+
+		// in directory mode, a missing TriggerTime means Now
+		if(directory_mode)
+			file.trigger_time_now = true;
 	}
 
 	std::string old_content_name = file.content_name;
 	std::string new_content_name;
 
 	// parse/check header extension
-	for(size_t offset = 7; offset < data.size();) {
+	for(size_t offset = 7; offset < len;) {
 		int pli = data[offset] >> 6;
 		int param_id = data[offset] & 0x3F;
 		offset++;
@@ -120,14 +169,14 @@ bool MOTObject::ParseCheckHeader(MOT_FILE& target_file) {
 			data_len = 4;
 			break;
 		case 0b11:
-			if(offset >= data.size())
+			if(offset >= len)
 				return false;
 			bool ext = data[offset] & 0x80;
 			data_len = data[offset] & 0x7F;
 			offset++;
 
 			if(ext) {
-				if(offset >= data.size())
+				if(offset >= len)
 					return false;
 				data_len = (data_len << 8) + data[offset];
 				offset++;
@@ -135,7 +184,7 @@ bool MOTObject::ParseCheckHeader(MOT_FILE& target_file) {
 			break;
 		}
 
-		if(offset + data_len - 1 >= data.size())
+		if(offset + data_len - 1 >= len)
 			return false;
 
 		// process parameter
@@ -187,37 +236,173 @@ bool MOTObject::IsToBeShown() {
 	// try to process finished header
 	if(header.IsFinished()) {
 		// parse/check MOT header
-		bool result = ParseCheckHeader(result_file);
+		const mot_data_t& header_data = header.GetData();
+		bool result = ParseCheckHeader(header_data.data(), header_data.size(), result_file, false);
+		if(result) {
+			shown_header = header_data;
+			shown_header_seg_size = header.GetSegSize();
+		}
 		header.Reset();	// allow for header updates
 		if(!result)
 			return false;
+		body.SetAnnouncedSize(result_file.body_size);
 	}
 
 	// abort, if incomplete/not yet triggered
 	if(!header_received)
 		return false;
-	if(!body.IsFinished() || GetCurrentBodySize() != GetTotalBodySize())
+	if(!body.IsFinished() || body.GetSize() != result_file.body_size)
 		return false;
 	if(!result_file.trigger_time_now)
 		return false;
 
-	// add body data
-	result_file.data = body.GetData();
+	// hand over body data (afterwards only kept there)
+	shown_body_seg_size = body.GetSegSize();
+	repeated_body_segs.assign(body.GetSegsCount(), false);
+	repeated_body_segs_count = 0;
+	result_file.data = std::make_shared<const mot_data_t>(body.TakeData());
 
 	shown = true;
 	return true;
 }
 
+bool MOTObject::CheckRepeatedSeg(bool dg_type_header, int seg_number, bool last_seg, const uint8_t* data, size_t len) {
+	// in directory mode, the header is not repeated as such
+	if(dg_type_header && shown_header.empty())
+		return true;
+
+	const mot_data_t& ref_data = dg_type_header ? shown_header : *result_file.data;
+	size_t ref_seg_size = dg_type_header ? shown_header_seg_size : shown_body_seg_size;
+
+	// the segment must match the segmentation of the shown object...
+	if(ref_seg_size == 0) {
+		// (single segment)
+		if(seg_number != 0 || !last_seg)
+			return false;
+	} else {
+		if(last_seg ? (len == 0 || len > ref_seg_size) : len != ref_seg_size)
+			return false;
+	}
+	size_t offset = seg_number * ref_seg_size;
+	if(last_seg ? offset + len != ref_data.size() : offset + len >= ref_data.size())
+		return false;
+
+	// ...and its content
+	if(len && memcmp(&ref_data[offset], data, len))
+		return false;
+
+	if(!dg_type_header && (size_t) seg_number < repeated_body_segs.size() && !repeated_body_segs[seg_number]) {
+		repeated_body_segs[seg_number] = true;
+		repeated_body_segs_count++;
+	}
+	return true;
+}
+
+double MOTObject::GetProgress() {
+	if(shown)
+		return 1;
+	return result_file.body_size ? (double) body.GetSize() / (double) result_file.body_size : -1;
+}
+
 
 // --- MOTManager -----------------------------------------------------------------
+MOTManager::~MOTManager() {
+	if(stats.evicted_partial_objects || stats.evicted_complete_objects)
+		fprintf(stderr, "MOTManager: cache evictions: %zu partial, %zu complete objects\n", stats.evicted_partial_objects, stats.evicted_complete_objects);
+}
+
 void MOTManager::Reset() {
-	object = MOTObject();
-	current_transport_id = -1;
+	cache.clear();
+	cache_lru.clear();
+	last_shown_transport_id = -1;
+
+	directory.Reset();
+	directory_transport_id = -1;
+}
+
+MOTObject& MOTManager::GetObject(int transport_id) {
+	// if already present, mark as most recently used
+	mot_cache_t::iterator it = cache.find(transport_id);
+	if(it != cache.end()) {
+		cache_lru.splice(cache_lru.begin(), cache_lru, it->second.lru_it);
+		return it->second.object;
+	}
+
+	cache_lru.push_front(transport_id);
+	MOT_CACHE_ENTRY& entry = cache[transport_id];
+	entry.lru_it = cache_lru.begin();
+	return entry.object;
+}
+
+void MOTManager::LimitCacheSize() {
+	size_t cache_size = 0;
+	for(mot_cache_t::value_type& entry : cache)
+		cache_size += entry.second.object.GetCacheSize();
+
+	// evict least recently used objects (but never the most recently used one)
+	while(cache_size > max_cache_size && cache.size() > 1) {
+		int transport_id = cache_lru.back();
+		MOTObject& object = cache.at(transport_id).object;
+
+		if(object.IsShown())
+			stats.evicted_complete_objects++;
+		else
+			stats.evicted_partial_objects++;
+
+		cache_size -= object.GetCacheSize();
+		cache.erase(transport_id);
+		cache_lru.pop_back();
+	}
+}
+
+void MOTManager::ProcessDirectory() {
+	mot_data_t data = directory.TakeData();	// allow for directory updates
+
+	// parse/check directory header (uncompressed only)
+	if(data.size() < 13)
+		return;
+
+	bool compression_flag = data[0] & 0x80;
+	size_t directory_size = ((data[0] & 0x3F) << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+	size_t number_of_objects = (data[4] << 8) | data[5];
+	size_t directory_extension_len = (data[11] << 8) | data[12];
+
+	if(compression_flag || directory_size != data.size())
+		return;
+
+	// iterate through all directory entries (transport ID + MOT header)
+	size_t offset = 13 + directory_extension_len;
+	for(size_t i = 0; i < number_of_objects; i++) {
+		if(offset + 2 + 7 > data.size())
+			return;
+
+		int transport_id = (data[offset] << 8) | data[offset + 1];
+		size_t header_size = ((data[offset + 5] & 0x0F) << 9) | (data[offset + 6] << 1) | (data[offset + 7] >> 7);
+		offset += 2;
+
+		if(header_size < 7 || offset + header_size > data.size())
+			return;
+
+		MOTObject& object = GetObject(transport_id);
+		object.SetDirectoryHeader(&data[offset], header_size);
+		offset += header_size;
+
+		// the body may already have been received
+		if(object.IsToBeShown())
+			ShowObject(transport_id, object);
+	}
+
+	LimitCacheSize();
 }
 
-bool MOTManager::ParseCheckDataGroupHeader(const std::vector<uint8_t>& dg, size_t& offset, int& dg_type) {
+void MOTManager::ShowObject(int transport_id, MOTObject& object) {
+	last_shown_transport_id = transport_id;
+	observer->MOTFileCompleted(object.GetFile());
+}
+
+bool MOTManager::ParseCheckDataGroupHeader(const uint8_t *dg, size_t dg_len, size_t& offset, int& dg_type) {
 	// parse/check Data Group header
-	if(dg.size() < (offset + 2))
+	if(dg_len < (offset + 2))
 		return false;
 
 	bool extension_flag = dg[offset] & 0x80;
@@ -233,15 +418,15 @@ bool MOTManager::ParseCheckDataGroupHeader(const std::vector<uint8_t>& dg, size_
 		return false;
 	if(!user_access_flag)
 		return false;
-	if(dg_type != 3 && dg_type != 4)	// only accept MOT header/body
+	if(dg_type != 3 && dg_type != 4 && dg_type != 6)	// only accept MOT header/body/directory (uncompressed)
 		return false;
 
 	return true;
 }
 
-bool MOTManager::ParseCheckSessionHeader(const std::vector<uint8_t>& dg, size_t& offset, bool& last_seg, int& seg_number, int& transport_id) {
+bool MOTManager::ParseCheckSessionHeader(const uint8_t *dg, size_t dg_len, size_t& offset, bool& last_seg, int& seg_number, int& transport_id) {
 	// parse/check session header
-	if(dg.size() < (offset + 3))
+	if(dg_len < (offset + 3))
 		return false;
 
 	last_seg = dg[offset] & 0x80;
@@ -256,7 +441,7 @@ bool MOTManager::ParseCheckSessionHeader(const std::vector<uint8_t>& dg, size_t&
 		return false;
 
 	// handle transport ID
-	if(dg.size() < (offset + len_indicator))
+	if(dg_len < (offset + len_indicator))
 		return false;
 
 	transport_id = (dg[offset] << 8) | dg[offset + 1];
@@ -265,22 +450,22 @@ bool MOTManager::ParseCheckSessionHeader(const std::vector<uint8_t>& dg, size_t&
 	return true;
 }
 
-bool MOTManager::ParseCheckSegmentationHeader(const std::vector<uint8_t>& dg, size_t& offset, size_t& seg_size) {
+bool MOTManager::ParseCheckSegmentationHeader(const uint8_t *dg, size_t dg_len, size_t& offset, size_t& seg_size) {
 	// parse/check segmentation header (MOT)
-	if(dg.size() < (offset + 2))
+	if(dg_len < (offset + 2))
 		return false;
 
 	seg_size = ((dg[offset] & 0x1F) << 8) | dg[offset + 1];
 	offset += 2;
 
 	// compare announced/actual segment size
-	if(seg_size != dg.size() - offset - CalcCRC::CRCLen)
+	if(seg_size != dg_len - offset - CalcCRC::CRCLen)
 		return false;
 
 	return true;
 }
 
-void MOTManager::HandleMOTDataGroup(const std::vector<uint8_t>& dg) {
+void MOTManager::HandleMOTDataGroup(const uint8_t *dg, size_t dg_len) {
 	size_t offset = 0;
 
 	// parse/check headers
@@ -290,29 +475,54 @@ void MOTManager::HandleMOTDataGroup(const std::vector<uint8_t>& dg) {
 	int transport_id;
 	size_t seg_size;
 
-	if(!ParseCheckDataGroupHeader(dg, offset, dg_type))
+	if(!ParseCheckDataGroupHeader(dg, dg_len, offset, dg_type))
 		return;
-	if(!ParseCheckSessionHeader(dg, offset, last_seg, seg_number, transport_id))
+	if(!ParseCheckSessionHeader(dg, dg_len, offset, last_seg, seg_number, transport_id))
 		return;
-	if(!ParseCheckSegmentationHeader(dg, offset, seg_size))
+	if(!ParseCheckSegmentationHeader(dg, dg_len, offset, seg_size))
 		return;
 
 
-	// add completed segment to MOT object (reset if necessary)
-	if(current_transport_id != transport_id) {
-		current_transport_id = transport_id;
-		object = MOTObject();
+	// add completed segment to MOT directory
+	if(dg_type == 6) {
+		if(directory_transport_id != transport_id) {
+			directory_transport_id = transport_id;
+			directory.Reset();
+		}
+		directory.AddSeg(seg_number, last_seg, &dg[offset], seg_size);
+
+		if(directory.IsFinished())
+			ProcessDirectory();
+		return;
+	}
+
+	// add completed segment to MOT object (other objects are kept)
+	MOTObject& object = GetObject(transport_id);
+	bool display = false;
+	if(object.IsShown()) {
+		// carousel repetition: show again when completely and identically repeated, if another object was shown meanwhile
+		if(object.CheckRepeatedSeg(dg_type == 3, seg_number, last_seg, &dg[offset], seg_size)) {
+			if(object.IsRepetitionComplete()) {
+				object.ResetRepetition();
+				display = transport_id != last_shown_transport_id;
+			}
+		} else {
+			// the transport ID is reused for a new object
+			object = MOTObject();
+		}
 	}
-	object.AddSeg(dg_type == 3, seg_number, last_seg, &dg[offset], seg_size);
+	if(!object.IsShown()) {
+		object.AddSeg(dg_type == 3, seg_number, last_seg, &dg[offset], seg_size);
 
-	// check if object shall be shown
-	bool display = object.IsToBeShown();
+		// check if object shall be shown
+		display = object.IsToBeShown();
+	}
 
 	// derive progress fraction (-1 = unknown, as header not yet received - but body segments)
-	double fraction = object.GetTotalBodySize() ? (double) object.GetCurrentBodySize() / (double) object.GetTotalBodySize() : -1;
+	double fraction = object.GetProgress();
 
-//	fprintf(stderr, "dg_type: %d, seg_number: %2d%s, transport_id: %5d, seg_size: %4zu; display: %s, curr/total body size: %5zu/%5zu, fraction: %f\n",
-//			dg_type, seg_number, last_seg ? " (LAST)" : "", transport_id, seg_size, display ? "true" : "false", object.GetCurrentBodySize(), object.GetTotalBodySize(), fraction);
+//	fprintf(stderr, "dg_type: %d, seg_number: %2d%s, transport_id: %5d, seg_size: %4zu; display: %s, fraction: %f\n",
+//			dg_type, seg_number, last_seg ? " (LAST)" : "", transport_id, seg_size, display ? "true" : "false", fraction);
 
 	/* update progress
 	 * - if unknown, update invoked for each segment for visible pulse()!
@@ -323,5 +533,7 @@ void MOTManager::HandleMOTDataGroup(const std::vector<uint8_t>& dg) {
 
 	// if object shall be shown, forward it
 	if(display)
-		observer->MOTFileCompleted(object.GetFile());
+		ShowObject(transport_id, object);
+
+	LimitCacheSize();
 }
@@ -23,15 +23,20 @@
 #include <stdio.h>
 #include <string.h>
 #include <string>
+#include <list>
 #include <map>
+#include <memory>
 #include <vector>
 
 #include "tools.h"
 
 
+typedef std::vector<uint8_t> mot_data_t;
+typedef std::shared_ptr<const mot_data_t> mot_data_ptr_t;
+
 // --- MOT_FILE -----------------------------------------------------------------
 struct MOT_FILE {
-	std::vector<uint8_t> data;
+	mot_data_ptr_t data;	// shared, as handed over to (possibly several) consumers
 
 	// from header core
 	size_t body_size;
@@ -61,26 +66,46 @@ struct MOT_FILE {
 
 
 typedef std::vector<uint8_t> seg_t;
-typedef std::map<int,seg_t> segs_t;
 
 // --- MOTEntity -----------------------------------------------------------------
+// assembles the segments in place, as all but the last segment have the same size
 class MOTEntity {
 private:
-	segs_t segs;
+	mot_data_t data;
+	std::vector<bool> segs_received;
+	size_t segs_count;
 	int last_seg_number;
+	size_t seg_size;		// 0 = not yet known
 	size_t size;
+	size_t max_size;		// announced size (if any); kept on reset
+
+	seg_t pending_last_seg;	// if received before the segment size is known
+
+	void PutSeg(int seg_number, size_t offset, const uint8_t* seg_data, size_t len);
 public:
-	MOTEntity() {Reset();}
+	MOTEntity() : max_size(max_unannounced_size) {Reset();}
 	void Reset() {
-		segs.clear();
+		data.clear();
+		segs_received.clear();
+		segs_count = 0;
 		last_seg_number = -1;
+		seg_size = 0;
 		size = 0;
+		pending_last_seg.clear();
 	}
 
-	void AddSeg(int seg_number, bool last_seg, const uint8_t* data, size_t len);
-	bool IsFinished();
+	void SetAnnouncedSize(size_t total_size);
+	void AddSeg(int seg_number, bool last_seg, const uint8_t* seg_data, size_t len);
+	bool IsFinished() {return last_seg_number != -1 && segs_count == (size_t) last_seg_number + 1;}
 	size_t GetSize() {return size;}
-	std::vector<uint8_t> GetData();
+	size_t GetSegSize() {return seg_size;}
+	size_t GetSegsCount() {return segs_count;}
+	size_t GetAllocatedSize() {return data.capacity() + pending_last_seg.capacity();}
+	const mot_data_t& GetData() {return data;}	// complete, if finished
+	mot_data_t TakeData();
+
+	static const size_t max_reserve_size;
+	static const size_t max_unannounced_size;
 };
 
 
@@ -94,16 +119,46 @@ private:
 
 	MOT_FILE result_file;
 
-	bool ParseCheckHeader(MOT_FILE& target_file);
+	// to verify carousel repetitions of the shown object
+	mot_data_t shown_header;	// empty in directory mode
+	size_t shown_header_seg_size;
+	size_t shown_body_seg_size;
+	std::vector<bool> repeated_body_segs;
+	size_t repeated_body_segs_count;
+
+	bool ParseCheckHeader(const uint8_t* data, size_t len, MOT_FILE& target_file, bool directory_mode);
 public:
-	MOTObject(): header_received(false), shown(false) {}
+	MOTObject(): header_received(false), shown(false), shown_header_seg_size(0), shown_body_seg_size(0), repeated_body_segs_count(0) {}
 
 	void AddSeg(bool dg_type_header, int seg_number, bool last_seg, const uint8_t* data, size_t len);
+	void SetDirectoryHeader(const uint8_t* data, size_t len);
 	bool IsToBeShown();
-	MOT_FILE GetFile() {return result_file;}
+	bool IsShown() {return shown;}
+	bool CheckRepeatedSeg(bool dg_type_header, int seg_number, bool last_seg, const uint8_t* data, size_t len);	// false = differs from the shown object
+	bool IsRepetitionComplete() {return repeated_body_segs_count == repeated_body_segs.size();}
+	void ResetRepetition() {repeated_body_segs.assign(repeated_body_segs.size(), false); repeated_body_segs_count = 0;}
+	const MOT_FILE& GetFile() {return result_file;}
+
+	double GetProgress();	// -1 = unknown (header not yet received)
+	size_t GetCacheSize() {return header.GetAllocatedSize() + body.GetAllocatedSize() + (result_file.data ? result_file.data->capacity() : 0) + shown_header.capacity();}
+};
+
+
+// --- MOT_CACHE_ENTRY -----------------------------------------------------------------
+struct MOT_CACHE_ENTRY {
+	MOTObject object;
+	std::list<int>::iterator lru_it;
+};
+
+typedef std::map<int,MOT_CACHE_ENTRY> mot_cache_t;	// transport ID -> MOT_CACHE_ENTRY
+
+
+// --- MOT_MANAGER_STATS -----------------------------------------------------------------
+struct MOT_MANAGER_STATS {
+	size_t evicted_partial_objects;		// dropped before completion
+	size_t evicted_complete_objects;
 
-	size_t GetCurrentBodySize() {return body.GetSize();}
-	size_t GetTotalBodySize() {return result_file.body_size;}
+	MOT_MANAGER_STATS() : evicted_partial_objects(0), evicted_complete_objects(0) {}
 };
 
 
@@ -122,17 +177,33 @@ class MOTManager {
 private:
 	MOTManagerObserver *observer;
 
-	MOTObject object;
-	int current_transport_id;
+	// several objects are reassembled concurrently (interleaved carousel)
+	mot_cache_t cache;
+	std::list<int> cache_lru;		// transport IDs; most recently used first
+	size_t max_cache_size;
+	MOT_MANAGER_STATS stats;
+	int last_shown_transport_id;
+
+	MOTObject& GetObject(int transport_id);
+	void LimitCacheSize();
+
+	// directory mode
+	MOTEntity directory;
+	int directory_transport_id;
+	void ProcessDirectory();
+
+	void ShowObject(int transport_id, MOTObject& object);
 
-	bool ParseCheckDataGroupHeader(const std::vector<uint8_t>& dg, size_t& offset, int& dg_type);
-	bool ParseCheckSessionHeader(const std::vector<uint8_t>& dg, size_t& offset, bool& last_seg, int& seg_number, int& transport_id);
-	bool ParseCheckSegmentationHeader(const std::vector<uint8_t>& dg, size_t& offset, size_t& seg_size);
+	bool ParseCheckDataGroupHeader(const uint8_t *dg, size_t dg_len, size_t& offset, int& dg_type);
+	bool ParseCheckSessionHeader(const uint8_t *dg, size_t dg_len, size_t& offset, bool& last_seg, int& seg_number, int& transport_id);
+	bool ParseCheckSegmentationHeader(const uint8_t *dg, size_t dg_len, size_t& offset, size_t& seg_size);
 public:
-	MOTManager(MOTManagerObserver *observer) : observer(observer) {Reset();}
+	MOTManager(MOTManagerObserver *observer, size_t max_cache_size = 4 * 1024 * 1024) : observer(observer), max_cache_size(max_cache_size) {Reset();}
+	~MOTManager();
 
 	void Reset();
-	void HandleMOTDataGroup(const std::vector<uint8_t>& dg);
+	void HandleMOTDataGroup(const uint8_t *dg, size_t dg_len);
+	const MOT_MANAGER_STATS& GetStats() const {return stats;}
 };
 
 #endif /* MOT_MANAGER_H_ */
@@ -176,7 +176,7 @@ void PADDecoder::Process(const uint8_t *xpad_data, size_t xpad_len, bool exact_x
 
 				// if new Data Group available, append it
 				if(mot_decoder.ProcessDataSubfield(start, xpad + xpad_offset, xpad_ci.len))
-					mot_manager->HandleMOTDataGroup(mot_decoder.GetMOTDataGroup());
+					mot_manager->HandleMOTDataGroup(mot_decoder.GetMOTDataGroup(), mot_decoder.GetMOTDataGroupLen());
 
 				xpad_ci_type_continued = mot_app_type + 1;
 			}
@@ -355,7 +355,8 @@ bool DynamicLabelDecoder::DecodeDataGroup() {
 	// create new segment
 	DL_SEG dl_seg;
 	memcpy(dl_seg.prefix, &dg_raw[0], 2);
-	dl_seg.chars.insert(dl_seg.chars.begin(), dg_raw.begin() + 2, dg_raw.begin() + 2 + field_len);
+	memcpy(dl_seg.chars, &dg_raw[2], field_len);
+	dl_seg.chars_len = field_len;
 
 	bool current_flag = cmd_dl_plus ? dl_seg.DLPlusLink() : dl_seg.Toggle();
 	bool dl_toggle;
@@ -370,7 +371,7 @@ bool DynamicLabelDecoder::DecodeDataGroup() {
 	DataGroup::Reset();
 
 //	fprintf(stderr, "DynamicLabelDecoder: segnum %d, toggle: %s, DL Plus: %s, chars_len: %2zu%s\n",
-//			dl_seg.SegNum(), dl_seg.Toggle() ? "Y" : "N", cmd_dl_plus ? "Y" : "N", dl_seg.chars.size(), dl_seg.Last() ? " [LAST]" : "");
+//			dl_seg.SegNum(), dl_seg.Toggle() ? "Y" : "N", cmd_dl_plus ? "Y" : "N", dl_seg.chars_len, dl_seg.Last() ? " [LAST]" : "");
 
 	if(cmd_dl_plus) {
 		// try to add segment
@@ -388,7 +389,7 @@ bool DynamicLabelDecoder::DecodeDataGroup() {
 
 	// append new label
 	label.Reset();
-	label.raw = dl_sr.label_raw;
+	label.raw.assign(dl_sr.label_raw, dl_sr.label_raw + dl_sr.label_raw_len);
 	label.charset = dl_sr.dl_segs[0].prefix[1] >> 4;
 
 	// if completed, append also DL Plus
@@ -399,7 +400,7 @@ bool DynamicLabelDecoder::DecodeDataGroup() {
 }
 
 void DynamicLabelDecoder::AppendDLPlus() {
-	std::vector<uint8_t>& dl_plus_cmd = dl_plus_sr.label_raw;
+	const uint8_t* dl_plus_cmd = dl_plus_sr.label_raw;
 
 	// abort, if not DL Plus tags command
 	if((dl_plus_cmd[0]) >> 4 != 0b0000)
@@ -420,7 +421,7 @@ void DynamicLabelDecoder::AppendDLPlus() {
 
 	// process tags
 	for(size_t i = 0; i < (nt + 1); i++) {
-		uint8_t* dl_plus_tag = &dl_plus_cmd[1 + i * 3];
+		const uint8_t* dl_plus_tag = &dl_plus_cmd[1 + i * 3];
 
 		int content_type = dl_plus_tag[0] & 0x7F;
 		size_t start_marker = dl_plus_tag[1] & 0x7F;
@@ -465,54 +466,62 @@ std::string DynamicLabelDecoder::ConvertDLPlusContentTypeToString(const int valu
 
 // --- DL_SEG_REASSEMBLER -----------------------------------------------------------------
 void DL_SEG_REASSEMBLER::Reset() {
-	dl_segs.clear();
-	label_raw.clear();
+	dl_segs_present = 0;
+	label_raw_len = 0;
 }
 
-bool DL_SEG_REASSEMBLER::AddSegment(DL_SEG &dl_seg) {
+bool DL_SEG_REASSEMBLER::AddSegment(const DL_SEG &dl_seg) {
 	// if there are already segments with other toggle value in cache, first clear it
 	bool current_toggle;
 	if(GetToggle(current_toggle) && current_toggle != dl_seg.Toggle())
-		dl_segs.clear();
+		dl_segs_present = 0;
 
 	// if the segment is already there, abort
-	if(dl_segs.find(dl_seg.SegNum()) != dl_segs.end())
+	int seg_num = dl_seg.SegNum();
+	if(dl_segs_present & (1 << seg_num))
 		return false;
 
 	// add segment
-	dl_segs[dl_seg.SegNum()] = dl_seg;
+	dl_segs[seg_num] = dl_seg;
+	dl_segs_present |= 1 << seg_num;
 
 	// check for complete label
 	return CheckForCompleteLabel();
 }
 
+const DL_SEG* DL_SEG_REASSEMBLER::GetFirstSegment() {
+	for(int i = 0; i < 8; i++)
+		if(dl_segs_present & (1 << i))
+			return &dl_segs[i];
+	return nullptr;
+}
+
 bool DL_SEG_REASSEMBLER::GetToggle(bool& result) {
-	if(dl_segs.empty())
+	const DL_SEG* dl_seg = GetFirstSegment();
+	if(!dl_seg)
 		return false;
-	result = dl_segs.cbegin()->second.Toggle();
+	result = dl_seg->Toggle();
 	return true;
 }
 
 bool DL_SEG_REASSEMBLER::GetDLPlusLink(bool& result) {
-	if(dl_segs.empty())
+	const DL_SEG* dl_seg = GetFirstSegment();
+	if(!dl_seg)
 		return false;
-	result = dl_segs.cbegin()->second.DLPlusLink();
+	result = dl_seg->DLPlusLink();
 	return true;
 }
 
 bool DL_SEG_REASSEMBLER::CheckForCompleteLabel() {
-	dl_segs_t::const_iterator it;
-
 	// check if all segments are in cache
 	int segs = 0;
 	for(int i = 0; i < 8; i++) {
-		it = dl_segs.find(i);
-		if(it == dl_segs.cend())
+		if(!(dl_segs_present & (1 << i)))
 			return false;
 
 		segs++;
 
-		if(it->second.Last())
+		if(dl_segs[i].Last())
 			break;
 
 		if(i == 7)
@@ -520,11 +529,13 @@ bool DL_SEG_REASSEMBLER::CheckForCompleteLabel() {
 	}
 
 	// append complete label
-	label_raw.clear();
-	for(int i = 0; i < segs; i++)
-		label_raw.insert(label_raw.end(), dl_segs[i].chars.begin(), dl_segs[i].chars.end());
+	label_raw_len = 0;
+	for(int i = 0; i < segs; i++) {
+		memcpy(label_raw + label_raw_len, dl_segs[i].chars, dl_segs[i].chars_len);
+		label_raw_len += dl_segs[i].chars_len;
+	}
 
-//	std::string label((const char*) &label_raw[0], label_raw.size());
+//	std::string label((const char*) label_raw, label_raw_len);
 //	fprintf(stderr, "DL_SEG_REASSEMBLER: new label: '%s'\n", label.c_str());
 	return true;
 }
@@ -556,9 +567,3 @@ bool MOTDecoder::DecodeDataGroup() {
 
 	return true;
 }
-
-std::vector<uint8_t> MOTDecoder::GetMOTDataGroup() {
-	std::vector<uint8_t> result(mot_len);
-	memcpy(&result[0], &dg_raw[0], mot_len);
-	return result;
-}
@@ -22,8 +22,6 @@
 #include <stdint.h>
 #include <string.h>
 #include <atomic>
-#include <list>
-#include <map>
 #include <string>
 #include <vector>
 
@@ -35,7 +33,8 @@
 // --- DL_SEG -----------------------------------------------------------------
 struct DL_SEG {
 	uint8_t prefix[2];
-	std::vector<uint8_t> chars;
+	uint8_t chars[16];
+	size_t chars_len;
 
 	bool Toggle() const {return prefix[0] & 0x80;}
 	bool First() const {return prefix[0] & 0x40;}
@@ -83,16 +82,19 @@ public:
 };
 
 
-typedef std::map<int,DL_SEG> dl_segs_t;
-
 // --- DL_SEG_REASSEMBLER -----------------------------------------------------------------
 struct DL_SEG_REASSEMBLER {
-	dl_segs_t dl_segs;
-	std::vector<uint8_t> label_raw;
+	DL_SEG dl_segs[8];
+	uint8_t dl_segs_present;	// bitmask by SegNum
+	uint8_t label_raw[8 * 16];
+	size_t label_raw_len;
+
+	DL_SEG_REASSEMBLER() {Reset();}
 
-	bool AddSegment(DL_SEG &dl_seg);
+	bool AddSegment(const DL_SEG &dl_seg);
 	bool CheckForCompleteLabel();
 	void Reset();
+	const DL_SEG* GetFirstSegment();
 
 	bool GetToggle(bool& result);
 	bool GetDLPlusLink(bool& result);
@@ -151,7 +153,7 @@ public:
 
 	void Reset();
 
-	DL_STATE GetLabel() {return label;}
+	const DL_STATE& GetLabel() {return label;}
 
 	static std::string ConvertDLPlusContentTypeToString(const int value);
 };
@@ -171,7 +173,8 @@ public:
 
 	void SetLen(size_t mot_len) {this->mot_len = mot_len;}
 
-	std::vector<uint8_t> GetMOTDataGroup();
+	const uint8_t* GetMOTDataGroup() {return &dg_raw[0];}
+	size_t GetMOTDataGroupLen() {return mot_len;}
 };
 
 
@@ -195,7 +198,7 @@ struct XPAD_CI {
 	}
 };
 
-typedef std::list<XPAD_CI> xpad_cis_t;
+typedef FixedVector<XPAD_CI,4> xpad_cis_t;
 
 
 // --- PADDecoderObserver -----------------------------------------------------------------
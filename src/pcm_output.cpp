@@ -20,11 +20,25 @@
 
 
 // --- PCMOutput -----------------------------------------------------------------
-PCMOutput::PCMOutput() : AudioOutput() {
+PCMOutput::PCMOutput(const std::string& filename) : AudioOutput() {
+	output_file = stdout;
+	if(!filename.empty()) {
+		output_file = fopen(filename.c_str(), "wb");
+		if(!output_file)
+			throw std::runtime_error("PCMOutput: error while opening output file '" + filename + "': " + std::string(strerror(errno)));
+	}
+
 	samplerate = 0;
 	channels = 0;
 
 	audio_mute = false;
+
+	writer = nullptr;
+}
+
+PCMOutput::~PCMOutput() {
+	if(output_file != stdout)
+		fclose(output_file);
 }
 
 void PCMOutput::StartAudio(int samplerate, int channels) {
@@ -34,6 +48,7 @@ void PCMOutput::StartAudio(int samplerate, int channels) {
 	this->samplerate = samplerate;
 	this->channels = channels;
 
+	audio_gain.SetFormat(samplerate, channels);
 	ChangeFormat(samplerate, channels);
 }
 
@@ -42,6 +57,26 @@ void PCMOutput::ChangeFormat(int samplerate, int channels) {
 }
 
 void PCMOutput::PutAudio(const uint8_t *data, size_t len) {
-	if(!audio_mute)
-		fwrite(data, len, 1, stdout);
+	if(audio_mute)
+		return;
+
+	// output untouched, if full volume
+	if(audio_gain.IsUnity()) {
+		WriteOutput(data, len);
+		return;
+	}
+
+	// output after volume adjustment
+	size_t samples = len / sizeof(int16_t);
+	if(audio_gain_buffer.size() < samples)
+		audio_gain_buffer.resize(samples);
+	audio_gain.Process(&audio_gain_buffer[0], (const int16_t*) data, samples);
+	WriteOutput((const uint8_t*) &audio_gain_buffer[0], len);
+}
+
+void PCMOutput::WriteOutput(const uint8_t *data, size_t len) {
+	if(writer)
+		writer->Write(data, len);
+	else
+		fwrite(data, len, 1, output_file);
 }
@@ -19,32 +19,47 @@
 #ifndef PCM_OUTPUT_H_
 #define PCM_OUTPUT_H_
 
+#include <errno.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <atomic>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
+#include "audio_gain.h"
 #include "audio_output.h"
+#include "batched_writer.h"
 
 
 // --- PCMOutput -----------------------------------------------------------------
 class PCMOutput : public AudioOutput {
 private:
+	FILE *output_file;
+
 	int samplerate;
 	int channels;
 
 	std::atomic<bool> audio_mute;
+	AudioGain audio_gain;
+	std::vector<int16_t> audio_gain_buffer;
+
+	BatchedWriter *writer;
 protected:
 	virtual void ChangeFormat(int samplerate, int channels);
+	void WriteOutput(const uint8_t *data, size_t len);
 public:
-	PCMOutput();
-	~PCMOutput() {}
+	PCMOutput(const std::string& filename = "");	// stdout, if no filename
+	~PCMOutput();
 
 	void StartAudio(int samplerate, int channels);
 	void StopAudio() {}
 	void PutAudio(const uint8_t *data, size_t len);
 	void SetAudioMute(bool audio_mute) {this->audio_mute = audio_mute;}
-	void SetAudioVolume(double) {}
-	bool HasAudioVolumeControl() {return false;}
+	void SetAudioVolume(double audio_volume) {audio_gain.SetGain(audio_volume);}
+	bool HasAudioVolumeControl() {return true;}
+	void SetBatchedWriter(BatchedWriter* writer) {if(output_file == stdout) this->writer = writer;}
 };
 
 #endif /* PCM_OUTPUT_H_ */
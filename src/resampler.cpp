@@ -0,0 +1,118 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "resampler.h"
+
+
+// --- Resampler -----------------------------------------------------------------
+Resampler::Resampler() {
+	channels = 1;
+	ratio = 1.0;
+	Reset();
+}
+
+void Resampler::SetFormat(int channels, size_t max_input_frames) {
+	this->channels = channels;
+	history.resize((max_input_frames + 4) * channels);	// incl. interpolation margin
+	Reset();
+}
+
+void Resampler::Reset() {
+	// start with a single silent frame before the first input frame
+	std::fill(history.begin(), history.end(), 0);
+	history_frames = 1;
+	position = 1.0;
+}
+
+size_t Resampler::GetInputFramesNeeded(size_t output_frames) {
+	if(output_frames == 0)
+		return 0;
+
+	// accumulate just like Process does, to get the identical (rounded) position of the last output frame
+	double last_position = position;
+	for(size_t i = 1; i < output_frames; i++)
+		last_position += ratio;
+
+	// the last output frame requires the following two input frames
+	size_t frames_needed = (size_t) last_position + 3;
+	return frames_needed > history_frames ? frames_needed - history_frames : 0;
+}
+
+void Resampler::PutInput(const int16_t *data, size_t frames) {
+	size_t samples_needed = (history_frames + frames) * channels;
+	if(history.size() < samples_needed)
+		history.resize(samples_needed);
+
+	memcpy(&history[history_frames * channels], data, frames * channels * sizeof(int16_t));
+	history_frames += frames;
+}
+
+size_t Resampler::Process(int16_t *dst, size_t output_frames) {
+	size_t frames = 0;
+	for(; frames < output_frames; frames++) {
+		size_t index = (size_t) position;
+		if(index + 2 >= history_frames)
+			break;
+
+		InterpolateFrame(dst + frames * channels, &history[(index - 1) * channels], position - index);
+		position += ratio;
+	}
+
+	// discard history no longer needed (keeping the frame before the current position)
+	size_t discard_frames = std::min((size_t) position - 1, history_frames);
+	if(discard_frames) {
+		memmove(&history[0], &history[discard_frames * channels], (history_frames - discard_frames) * channels * sizeof(int16_t));
+		history_frames -= discard_frames;
+		position -= discard_frames;
+	}
+
+	return frames;
+}
+
+void Resampler::InterpolateFrame(int16_t *dst, const int16_t *src, float t) {
+	// Catmull-Rom weights for the frames at -1, 0, +1, +2
+	float t2 = t * t;
+	float t3 = t2 * t;
+	float w0 = 0.5f * (-t3 + 2.0f * t2 - t);
+	float w1 = 0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f);
+	float w2 = 0.5f * (-3.0f * t3 + 4.0f * t2 + t);
+	float w3 = 0.5f * (t3 - t2);
+
+#if defined(__SSE2__)
+	if(channels == 2) {
+		// all four stereo frames at once: [L0 R0 L1 R1] and [L2 R2 L3 R3]
+		__m128i s = _mm_loadu_si128((const __m128i*) src);
+		__m128 f01 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+		__m128 f23 = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+		__m128 sum = _mm_add_ps(_mm_mul_ps(f01, _mm_setr_ps(w0, w0, w1, w1)), _mm_mul_ps(f23, _mm_setr_ps(w2, w2, w3, w3)));
+		sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+
+		__m128i result = _mm_cvtps_epi32(sum);	// rounded
+		result = _mm_packs_epi32(result, result);	// saturated
+		int32_t frame = _mm_cvtsi128_si32(result);
+		memcpy(dst, &frame, sizeof(frame));
+		return;
+	}
+#endif
+
+	for(int c = 0; c < channels; c++) {
+		float value = w0 * src[c] + w1 * src[channels + c] + w2 * src[2 * channels + c] + w3 * src[3 * channels + c];
+		value = lrintf(value);
+		dst[c] = value > 32767.0f ? 32767 : (value < -32768.0f ? -32768 : (int16_t) value);
+	}
+}
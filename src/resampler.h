@@ -0,0 +1,59 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESAMPLER_H_
+#define RESAMPLER_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+// --- Resampler -----------------------------------------------------------------
+// resamples interleaved S16 frames by an arbitrary (and variable) ratio, using cubic (Catmull-Rom) interpolation
+class Resampler {
+private:
+	int channels;
+	double ratio;		// input frames per output frame
+	double position;	// in input frames, relative to the start of the history
+
+	std::vector<int16_t> history;	// not yet fully consumed input frames
+	size_t history_frames;
+
+	void InterpolateFrame(int16_t *dst, const int16_t *src, float t);
+public:
+	Resampler();
+
+	void SetFormat(int channels, size_t max_input_frames);
+	void SetRatio(double ratio) {this->ratio = ratio;}
+	double GetRatio() {return ratio;}
+	void Reset();
+
+	size_t GetInputFramesNeeded(size_t output_frames);
+	size_t GetBufferedFrames() {return history_frames - (size_t) position;}
+	void PutInput(const int16_t *data, size_t frames);
+	size_t Process(int16_t *dst, size_t output_frames);	// returns the number of output frames
+};
+
+#endif /* RESAMPLER_H_ */
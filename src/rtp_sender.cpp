@@ -0,0 +1,431 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rtp_sender.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+
+// --- RTPSender -----------------------------------------------------------------
+const size_t RTPSender::max_payload_len = 1400;	// incl. payload specific header; fits into Ethernet MTU
+const size_t RTPSender::max_batch_packets = 256;
+const int RTPSender::default_ttl = 1;
+
+RTPSender::RTPSender(int ttl) {
+	this->ttl = ttl;
+
+	packets_count = 0;
+	send_error = false;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if(fd == -1)
+		throw std::runtime_error("RTPSender: error while creating socket: " + std::string(strerror(errno)));
+
+	unsigned char mc_ttl = ttl;
+	if(setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &mc_ttl, sizeof(mc_ttl)))
+		perror("RTPSender: error while setting multicast TTL");
+}
+
+RTPSender::~RTPSender() {
+	Flush();
+
+	fprintf(stderr, "RTPSender: %zu packets (%zu bytes) sent using %zu syscalls; %zu packets dropped\n",
+			stats.packets, stats.bytes, stats.syscalls, stats.dropped_packets);
+
+	close(fd);
+}
+
+bool RTPSender::ParseDestination(const std::string& spec, std::string& address, int& port) {
+	// <address>:<port>
+	size_t sep = spec.rfind(':');
+	if(sep == std::string::npos || sep == 0)
+		return false;
+	address = spec.substr(0, sep);
+
+	char* endptr;
+	long value = strtol(spec.c_str() + sep + 1, &endptr, 10);
+	if(endptr == spec.c_str() + sep + 1 || *endptr || value < 1 || value > 65535)
+		return false;
+	port = value;
+
+	struct sockaddr_in addr;
+	return SetAddress(address, port, addr);
+}
+
+bool RTPSender::SetAddress(const std::string& address, int port, struct sockaddr_in& addr) {
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	return inet_pton(AF_INET, address.c_str(), &addr.sin_addr) == 1;
+}
+
+void RTPSender::QueuePacket(const struct sockaddr_in& dest, const uint8_t *header, size_t header_len, const uint8_t *payload, size_t payload_len) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if(packets_count == max_batch_packets)
+		SendPackets();
+
+	// reuse the buffers of earlier batches
+	if(packets_count == packets.size())
+		packets.emplace_back();
+	RTP_SENDER_PACKET& packet = packets[packets_count++];
+	packet.data.assign(header, header + header_len);
+	packet.data.insert(packet.data.end(), payload, payload + payload_len);
+	packet.dest = dest;
+}
+
+void RTPSender::Flush() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	SendPackets();
+}
+
+RTP_SENDER_STATS RTPSender::GetStats() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return stats;
+}
+
+void RTPSender::SendPackets() {
+	// mutex must already be locked!
+	if(!packets_count)
+		return;
+
+	std::vector<struct iovec> iovs(packets_count);
+	std::vector<struct msghdr> msgs(packets_count);
+	for(size_t i = 0; i < packets_count; i++) {
+		iovs[i].iov_base = &packets[i].data[0];
+		iovs[i].iov_len = packets[i].data.size();
+
+		memset(&msgs[i], 0, sizeof(msgs[i]));
+		msgs[i].msg_name = &packets[i].dest;
+		msgs[i].msg_namelen = sizeof(packets[i].dest);
+		msgs[i].msg_iov = &iovs[i];
+		msgs[i].msg_iovlen = 1;
+	}
+
+	size_t index = 0;
+	while(index < packets_count) {
+		size_t sent;
+#ifdef __linux__
+		// send all packets of the batch (usually all services of a frame) with a single syscall
+		std::vector<struct mmsghdr> mmsgs(packets_count - index);
+		for(size_t i = 0; i < mmsgs.size(); i++) {
+			mmsgs[i].msg_hdr = msgs[index + i];
+			mmsgs[i].msg_len = 0;
+		}
+		int result = sendmmsg(fd, &mmsgs[0], mmsgs.size(), 0);
+		stats.syscalls++;
+		if(result > 0) {
+			for(int i = 0; i < result; i++)
+				stats.bytes += mmsgs[i].msg_len;
+		}
+#else
+		ssize_t result = sendmsg(fd, &msgs[index], 0);
+		stats.syscalls++;
+		if(result > 0) {
+			stats.bytes += result;
+			result = 1;
+		}
+#endif
+		if(result == -1) {
+			if(errno == EINTR)
+				continue;
+
+			// skip the failed packet; report only the first of consecutive errors
+			if(!send_error) {
+				perror("RTPSender: error while sending packets");
+				send_error = true;
+			}
+			stats.dropped_packets++;
+			index++;
+			continue;
+		}
+		send_error = false;
+
+		sent = result;
+		stats.packets += sent;
+		index += sent;
+	}
+
+	packets_count = 0;
+}
+
+
+// --- RTPStream -----------------------------------------------------------------
+const int RTPStream::payload_type_mpa = 14;	// static (RFC 3551)
+const int RTPStream::payload_type_aac = 96;	// dynamic
+
+static const int aac_sampling_frequencies[] = {96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350};
+
+RTPStream::RTPStream(RTPSender *sender, const std::string& address, int port) {
+	this->sender = sender;
+
+	if(!RTPSender::SetAddress(address, port, dest))
+		throw std::runtime_error("RTPStream: invalid address '" + address + "'");
+	dest_str = address + ":" + std::to_string(port);
+
+	// random initial values (RFC 3550)
+	std::random_device rd;
+	ssrc = rd();
+	seq = rd();
+	timestamp = rd();
+
+	payload_type = -1;
+	clock_rate = 0;
+	channels = 0;
+	ps = false;
+}
+
+void RTPStream::UntouchedStreamChangeFormat(const std::string& file_extension) {
+	asc.clear();
+	channels = 0;
+	ps = false;
+
+	if(file_extension == "mp2") {
+		payload_type = payload_type_mpa;
+		clock_rate = 90000;
+		PrintSDP();
+	} else if(file_extension == "aac") {
+		// clock rate and config known from the first AU
+		payload_type = payload_type_aac;
+		clock_rate = 0;
+	} else {
+		payload_type = -1;
+		clock_rate = 0;
+	}
+}
+
+void RTPStream::UntouchedStreamAudioFormat(const AUDIO_SERVICE_FORMAT& format) {
+	if(payload_type != payload_type_aac)
+		return;
+
+	bool new_ps = format.codec == "HE-AAC v2";
+	if(new_ps == ps)
+		return;
+	ps = new_ps;
+
+	// the ASC may not change along with PS
+	if(!asc.empty())
+		PrintSDP();
+}
+
+std::string RTPStream::GetSDP() const {
+	if(payload_type == -1 || !clock_rate)
+		return "";
+
+	std::string address = dest_str.substr(0, dest_str.rfind(':'));
+	std::string connection = address;
+	if(IN_MULTICAST(ntohl(dest.sin_addr.s_addr)))
+		connection += "/" + std::to_string(sender->GetTTL());
+
+	std::string sdp =
+			"v=0\n"
+			"o=- " + std::to_string(ssrc) + " 0 IN IP4 " + address + "\n"
+			"s=DABlin\n"
+			"c=IN IP4 " + connection + "\n"
+			"t=0 0\n"
+			"m=audio " + std::to_string(ntohs(dest.sin_port)) + " RTP/AVP " + std::to_string(payload_type) + "\n";
+
+	if(payload_type == payload_type_mpa) {
+		sdp += "a=rtpmap:" + std::to_string(payload_type) + " MPA/90000\n";
+	} else {
+		std::string config;
+		for(const uint8_t& byte : asc) {
+			char hex[3];
+			snprintf(hex, sizeof(hex), "%02X", byte);
+			config += hex;
+		}
+
+		// profile: AAC Profile L2, High Efficiency AAC Profile L2 or High Efficiency AAC v2 Profile L2 (PS output is stereo)
+		bool sbr = (asc[0] >> 3) == 5;
+		sdp +=
+			"a=rtpmap:" + std::to_string(payload_type) + " mpeg4-generic/" + std::to_string(clock_rate) + "/" + std::to_string(ps ? 2 : channels) + "\n"
+			"a=fmtp:" + std::to_string(payload_type) + " streamtype=5; profile-level-id=" + (ps ? "48" : (sbr ? "44" : "41")) + "; mode=AAC-hbr; config=" + config + "; "
+			"sizeLength=13; indexLength=3; indexDeltaLength=3\n";
+	}
+	return sdp;
+}
+
+void RTPStream::PrintSDP() {
+	fprintf(stderr, "RTPStream: sending to %s; SDP:\n%s", dest_str.c_str(), GetSDP().c_str());
+}
+
+void RTPStream::ProcessUntouchedStream(const uint8_t* data, size_t len, size_t duration_ms) {
+	UNTOUCHED_STREAM_PART part = {data, len};
+	ProcessUntouchedStreamParts(&part, 1, duration_ms);
+}
+
+void RTPStream::ProcessUntouchedStreamParts(const UNTOUCHED_STREAM_PART* parts, size_t count, size_t duration_ms) {
+	if(payload_type == payload_type_mpa) {
+		ProcessMP2(parts, count);
+	} else if(payload_type == payload_type_aac) {
+		if(count != 1)
+			return;
+		ProcessAAC(parts[0].data, parts[0].len);
+	}
+
+	// the timestamp of the next frame/AU
+	timestamp += duration_ms * clock_rate / 1000;
+}
+
+void RTPStream::UntouchedStreamGap(size_t duration_ms) {
+	// keep the timestamps in line with the elapsed time, so that receivers conceal the gap
+	timestamp += duration_ms * clock_rate / 1000;
+}
+
+void RTPStream::SendPayload(const uint8_t *header, size_t header_len, const uint8_t *data, size_t len, bool marker) {
+	uint8_t packet_header[16];
+
+	// RTP header (RFC 3550)
+	packet_header[0] = 0x80;	// V=2, no padding/extension/CSRC
+	packet_header[1] = (marker ? 0x80 : 0x00) | payload_type;
+	packet_header[2] = seq >> 8;
+	packet_header[3] = seq;
+	packet_header[4] = timestamp >> 24;
+	packet_header[5] = timestamp >> 16;
+	packet_header[6] = timestamp >> 8;
+	packet_header[7] = timestamp;
+	packet_header[8] = ssrc >> 24;
+	packet_header[9] = ssrc >> 16;
+	packet_header[10] = ssrc >> 8;
+	packet_header[11] = ssrc;
+
+	// payload specific header
+	memcpy(packet_header + 12, header, header_len);
+
+	sender->QueuePacket(dest, packet_header, 12 + header_len, data, len);
+	seq++;
+}
+
+void RTPStream::ProcessMP2(const UNTOUCHED_STREAM_PART* parts, size_t count) {
+	payload.clear();
+	for(size_t i = 0; i < count; i++)
+		payload.insert(payload.end(), parts[i].data, parts[i].data + parts[i].len);
+
+	// one frame per packet; fragmented, if too large (RFC 2250)
+	const size_t max_len = RTPSender::max_payload_len - 4;
+	for(size_t offset = 0; offset < payload.size(); offset += max_len) {
+		uint8_t header[4] = {0x00, 0x00, (uint8_t) (offset >> 8), (uint8_t) offset};	// MBZ, Frag_offset
+		SendPayload(header, sizeof(header), &payload[offset], std::min(max_len, payload.size() - offset), false);
+	}
+}
+
+void RTPStream::ProcessAAC(const uint8_t *data, size_t len) {
+	std::vector<uint8_t> new_asc;
+	int new_clock_rate;
+	int new_channels;
+	if(!ParseLATM(data, len, new_asc, new_clock_rate, new_channels)) {
+		fprintf(stderr, "RTPStream: %s: unsupported LATM frame - ignored\n", dest_str.c_str());
+		return;
+	}
+	if(au.size() > 0x1FFF)
+		return;
+
+	if(new_asc != asc) {
+		asc = new_asc;
+		clock_rate = new_clock_rate;
+		channels = new_channels;
+		PrintSDP();
+	}
+
+	// one AU per packet; fragmented, if too large (RFC 3640, AAC-hbr mode)
+	uint8_t header[4] = {0x00, 16, (uint8_t) (au.size() >> 5), (uint8_t) (au.size() << 3)};	// AU-headers-length, AU-size/AU-Index
+	const size_t max_len = RTPSender::max_payload_len - sizeof(header);
+	for(size_t offset = 0; offset < au.size(); offset += max_len) {
+		size_t fragment_len = std::min(max_len, au.size() - offset);
+		SendPayload(header, sizeof(header), &au[offset], fragment_len, offset + fragment_len == au.size());
+	}
+}
+
+bool RTPStream::ParseLATM(const uint8_t *data, size_t len, std::vector<uint8_t>& new_asc, int& new_clock_rate, int& new_channels) {
+	// parses the LATM frames created by SuperframeFilter (a single AU with in-band config)
+	BitReader br(data, len);
+	int value;
+
+	// AudioSyncStream()
+	if(!br.GetBits(value, 11) || value != 0x2B7)
+		return false;
+	if(!br.GetBits(value, 13))
+		return false;
+
+	// AudioMuxElement(1)
+	if(!br.GetBits(value, 1) || value != 0)		// useSameStreamMux
+		return false;
+
+	// StreamMuxConfig()
+	if(!br.GetBits(value, 1) || value != 0)		// audioMuxVersion
+		return false;
+	if(!br.GetBits(value, 1 + 6 + 4 + 3) || value != 1 << 13)	// allStreamsSameTimeFraming, numSubFrames, numProgram, numLayer
+		return false;
+
+	// AudioSpecificConfig() - copied as is
+	BitWriter asc_bw;
+	int aot, sr_index, ch_config, ext_sr_index = -1;
+	if(!br.GetBits(aot, 5) || !br.GetBits(sr_index, 4) || !br.GetBits(ch_config, 4))
+		return false;
+	asc_bw.AddBits(aot, 5);
+	asc_bw.AddBits(sr_index, 4);
+	asc_bw.AddBits(ch_config, 4);
+	if(aot == 5) {
+		if(!br.GetBits(ext_sr_index, 4) || !br.GetBits(aot, 5))
+			return false;
+		asc_bw.AddBits(ext_sr_index, 4);
+		asc_bw.AddBits(aot, 5);
+	}
+	if(aot != 2 || !br.GetBits(value, 3) || (value & 0b011))	// GASpecificConfig() - only the frameLengthFlag may be set
+		return false;
+	asc_bw.AddBits(value, 3);
+	new_asc.assign(asc_bw.GetData(), asc_bw.GetData() + asc_bw.GetSize());
+
+	int out_sr_index = ext_sr_index != -1 ? ext_sr_index : sr_index;
+	if(out_sr_index >= (int) (sizeof(aac_sampling_frequencies) / sizeof(aac_sampling_frequencies[0])))
+		return false;
+	new_clock_rate = aac_sampling_frequencies[out_sr_index];
+	new_channels = ch_config;
+
+	if(!br.GetBits(value, 3) || value != 0)		// frameLengthType
+		return false;
+	if(!br.GetBits(value, 8 + 1 + 1) || (value & 0b11))	// latmBufferFullness, otherDataPresent, crcCheckPresent
+		return false;
+
+	// PayloadLengthInfo()
+	size_t au_len = 0;
+	do {
+		if(!br.GetBits(value, 8))
+			return false;
+		au_len += value;
+	} while(value == 0xFF);
+
+	// PayloadMux() - not byte-aligned
+	au.resize(au_len);
+	for(size_t i = 0; i < au_len; i++) {
+		if(!br.GetBits(value, 8))
+			return false;
+		au[i] = value;
+	}
+	return true;
+}
@@ -0,0 +1,123 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RTP_SENDER_H_
+#define RTP_SENDER_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <netinet/in.h>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "subchannel_sink.h"
+#include "tools.h"
+
+
+// --- RTP_SENDER_STATS -----------------------------------------------------------------
+struct RTP_SENDER_STATS {
+	size_t packets;
+	size_t bytes;
+	size_t syscalls;
+	size_t dropped_packets;
+
+	RTP_SENDER_STATS() : packets(0), bytes(0), syscalls(0), dropped_packets(0) {}
+};
+
+
+// --- RTP_SENDER_PACKET -----------------------------------------------------------------
+struct RTP_SENDER_PACKET {
+	std::vector<uint8_t> data;	// capacity kept for reuse
+	struct sockaddr_in dest;
+};
+
+
+// --- RTPSender -----------------------------------------------------------------
+// sends the queued packets of all streams at once, using a single UDP socket
+class RTPSender {
+private:
+	int fd;
+	int ttl;
+
+	std::mutex mutex;
+	std::vector<RTP_SENDER_PACKET> packets;
+	size_t packets_count;
+	RTP_SENDER_STATS stats;
+	bool send_error;
+
+	void SendPackets();
+public:
+	RTPSender(int ttl);
+	~RTPSender();
+
+	void QueuePacket(const struct sockaddr_in& dest, const uint8_t *header, size_t header_len, const uint8_t *payload, size_t payload_len);
+	void Flush();
+	RTP_SENDER_STATS GetStats();
+	int GetTTL() const {return ttl;}
+
+	static bool ParseDestination(const std::string& spec, std::string& address, int& port);
+	static bool SetAddress(const std::string& address, int port, struct sockaddr_in& addr);
+
+	static const size_t max_payload_len;
+	static const size_t max_batch_packets;
+	static const int default_ttl;
+};
+
+
+// --- RTPStream -----------------------------------------------------------------
+// packetizes the untouched stream of a single service (MP2: RFC 2250, AAC: RFC 3640)
+class RTPStream : public UntouchedStreamConsumer {
+private:
+	RTPSender *sender;
+	struct sockaddr_in dest;
+	std::string dest_str;
+
+	uint32_t ssrc;
+	uint16_t seq;
+	uint32_t timestamp;
+
+	int payload_type;
+	int clock_rate;
+	int channels;
+	bool ps;	// implicitly signalled, so not visible in the ASC
+	std::vector<uint8_t> asc;	// AudioSpecificConfig (AAC only)
+	std::vector<uint8_t> au;
+	std::vector<uint8_t> payload;
+
+	void SendPayload(const uint8_t *header, size_t header_len, const uint8_t *data, size_t len, bool marker);
+	void ProcessMP2(const UNTOUCHED_STREAM_PART* parts, size_t count);
+	void ProcessAAC(const uint8_t *data, size_t len);
+	bool ParseLATM(const uint8_t *data, size_t len, std::vector<uint8_t>& new_asc, int& new_clock_rate, int& new_channels);
+	void PrintSDP();
+public:
+	RTPStream(RTPSender *sender, const std::string& address, int port);
+
+	void ProcessUntouchedStream(const uint8_t* data, size_t len, size_t duration_ms);
+	void ProcessUntouchedStreamParts(const UNTOUCHED_STREAM_PART* parts, size_t count, size_t duration_ms);
+	void UntouchedStreamChangeFormat(const std::string& file_extension);
+	void UntouchedStreamAudioFormat(const AUDIO_SERVICE_FORMAT& format);
+	void UntouchedStreamGap(size_t duration_ms);
+
+	std::string GetSDP() const;
+
+	static const int payload_type_mpa;
+	static const int payload_type_aac;
+};
+
+#endif /* RTP_SENDER_H_ */
@@ -23,17 +23,46 @@ static void sdl_audio_callback(void *userdata, Uint8 *stream, int len) {
 	audio_source->AudioCallback(stream, len);
 }
 
+static int64_t steady_clock_ms() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 
 // --- SDLOutput -----------------------------------------------------------------
+const size_t SDLOutput::default_audio_latency_ms = 125;
+const double SDLOutput::playout_fill_avg_alpha = 0.02;	// per callback
+const double SDLOutput::playout_kp = 0.1;			// per second of deviation
+const double SDLOutput::playout_ki = 0.00006;		// per second of deviation and callback
+const double SDLOutput::playout_max_deviation = 0.002;	// 2000 ppm
+const int SDLOutput::fixed_samplerate = 48000;
+const int SDLOutput::fixed_channels = 2;
+
 SDLOutput::SDLOutput() : AudioOutput() {
 	audio_device = 0;
 	silence_len = 0;
 
 	samplerate = 0;
 	channels = 0;
+	buffer_channels = 0;
+	fixed_output_format = false;
 
 	audio_buffer = nullptr;
 	audio_start_buffer_size = 0;
+	audio_prebuffer_requests = 0;
+	audio_prebuffer_requests_done = 0;
+	audio_prebuffering = false;
+
+	audio_latency_ms = default_audio_latency_ms;
+	audio_fill_avg = 0.0;
+	audio_drift_integral = 0.0;
+	audio_drift_ppm = 0.0;
+
+	audio_start_time = 0;
+	audio_start_delay_ms = 0;
+
+	underruns = 0;
+	overruns = 0;
+	overrun_bytes = 0;
 
 	audio_mute = false;
 	audio_volume = 1.0;
@@ -53,6 +82,21 @@ SDLOutput::~SDLOutput() {
 	SDL_Quit();
 
 	delete audio_buffer;
+
+	SDL_OUTPUT_STATS stats = GetStats();
+	if(stats.underruns || stats.overruns)
+		fprintf(stderr, "SDLOutput: %zu underruns, %zu overruns (%zu bytes dropped)\n", stats.underruns, stats.overruns, stats.overrun_bytes);
+	fprintf(stderr, "SDLOutput: last drift compensation: %+.0f ppm; last start delay: %zu ms\n", stats.drift_ppm, stats.start_delay_ms);
+}
+
+SDL_OUTPUT_STATS SDLOutput::GetStats() {
+	SDL_OUTPUT_STATS result;
+	result.underruns = underruns;
+	result.overruns = overruns;
+	result.overrun_bytes = overrun_bytes;
+	result.drift_ppm = audio_drift_ppm;
+	result.start_delay_ms = audio_start_delay_ms;
+	return result;
 }
 
 void SDLOutput::StopAudio() {
@@ -64,39 +108,49 @@ void SDLOutput::StopAudio() {
 }
 
 void SDLOutput::StartAudio(int samplerate, int channels) {
+	audio_start_time = steady_clock_ms();
+
 	// if no change, do quick restart
+	// (the callback applies both clear and prebuffering request without locking)
 	if(audio_device && this->samplerate == samplerate && this->channels == channels) {
-		std::lock_guard<std::mutex> lock(audio_buffer_mutex);
 		audio_buffer->Clear();
-		SetAudioStartBufferSize();
+		audio_prebuffer_requests++;
+		return;
+	}
+
+	// with fixed output format, keep the device open and only switch the input format
+	if(audio_device && fixed_output_format) {
+		SDL_LockAudioDevice(audio_device);
+		SetInputFormat(samplerate, channels);
+		audio_buffer->Clear();
+		audio_prebuffer_requests++;
+		SDL_UnlockAudioDevice(audio_device);
 		return;
 	}
-	this->samplerate = samplerate;
-	this->channels = channels;
 
 	StopAudio();
 
-	// (re)init buffer
-	{
-		std::lock_guard<std::mutex> lock(audio_buffer_mutex);
+	// (re)init buffer - the callback is not running anymore
+	if(audio_buffer)
+		delete audio_buffer;
 
-		if(audio_buffer)
-			delete audio_buffer;
+	// use buffer of (at least) 500ms, but four times the target latency
+	int output_samplerate = fixed_output_format ? fixed_samplerate : samplerate;
+	int output_channels = fixed_output_format ? fixed_channels : channels;
+	size_t buffer_ms = std::max((size_t) 500, audio_latency_ms * 4);
+	size_t buffersize = output_samplerate * buffer_ms / 1000 * output_channels * sizeof(int16_t);
+	fprintf(stderr, "SDLOutput: using audio buffer of %zu bytes; target latency: %zu ms\n", buffersize, audio_latency_ms);
+	audio_buffer = new SPSCRingBuffer(buffersize);
 
-		// use 500ms buffer
-		size_t buffersize = samplerate / 2 * channels * 2;
-		fprintf(stderr, "SDLOutput: using audio buffer of %zu bytes\n", buffersize);
-		audio_buffer = new CircularBuffer(buffersize);
-		SetAudioStartBufferSize();
-	}
+	audio_gain.SetFormat(output_samplerate, output_channels);
 
 	// init audio
 	SDL_AudioSpec desired;
 	SDL_AudioSpec obtained;
-	desired.freq = samplerate;
+	desired.freq = output_samplerate;
 	desired.format = AUDIO_S16SYS;
-	desired.channels = channels;
-	desired.samples = samplerate * 0.024 * channels;	// DAB frame
+	desired.channels = output_channels;
+	desired.samples = output_samplerate * 0.024 * output_channels;	// DAB frame
 	desired.callback = sdl_audio_callback;
 	desired.userdata = (AudioSource*) this;
 
@@ -113,26 +167,61 @@ void SDLOutput::StartAudio(int samplerate, int channels) {
 
 	audio_spec = obtained;
 
+	// the callback is not running yet
+	SetInputFormat(samplerate, channels);
+	audio_prebuffering = true;
+
 	SDL_PauseAudioDevice(audio_device, 0);
 }
 
-void SDLOutput::SetAudioStartBufferSize() {
-	// start audio when 1/4 filled
-	audio_start_buffer_size = audio_buffer->Capacity() / 4;
+void SDLOutput::SetInputFormat(int samplerate, int channels) {
+	// (the callback must not be running)
+	this->samplerate = samplerate;
+	this->channels = channels;
+
+	// with fixed output format, mono input is mapped to stereo before buffering
+	buffer_channels = fixed_output_format ? fixed_channels : channels;
+	size_t frame_size = buffer_channels * sizeof(int16_t);
+	if(fixed_output_format)
+		fprintf(stderr, "SDLOutput: converting input freq: %d, channels: %d to fixed output format\n", samplerate, channels);
+
+	// start audio when the target latency is reached
+	audio_start_buffer_size = samplerate * audio_latency_ms / 1000 * frame_size;
+
+	// the resampler shall never need more input frames than a callback plus correction
+	double ratio_max = (double) samplerate / audio_spec.freq * (1.0 + playout_max_deviation);
+	audio_resampler.SetFormat(buffer_channels, audio_spec.samples * ratio_max + 1);
+	ResetPlayout();
 }
 
 void SDLOutput::PutAudio(const uint8_t *data, size_t len) {
-	std::lock_guard<std::mutex> lock(audio_buffer_mutex);
+	// map mono to stereo, if needed
+	if(buffer_channels == 2 && channels == 1) {
+		size_t samples = len / sizeof(int16_t);
+		if(audio_upmix_buffer.size() < samples * 2)
+			audio_upmix_buffer.resize(samples * 2);
+
+		const int16_t *src = (const int16_t*) data;
+		for(size_t i = 0; i < samples; i++) {
+			audio_upmix_buffer[i * 2] = src[i];
+			audio_upmix_buffer[i * 2 + 1] = src[i];
+		}
+		data = (const uint8_t*) &audio_upmix_buffer[0];
+		len = samples * 2 * sizeof(int16_t);
+	}
 
-	size_t capa = audio_buffer->Capacity() - audio_buffer->Size();
+	size_t capa = audio_buffer->Free();
 //	if(capa < len) {
 //		fprintf(stderr, "SDLOutput: audio buffer overflow, therefore cleaning buffer!\n");
 //		audio_buffer->Clear();
 //		capa = audio_buffer->capacity();
 //	}
 
-	if(len > capa)
+	if(len > capa) {
 		fprintf(stderr, "SDLOutput: audio buffer overflow: %zu > %zu\n", len, capa);
+		overruns++;
+		overrun_bytes += len - capa;
+	}
 
 	audio_buffer->Write(data, len);
 
@@ -152,36 +241,79 @@ void SDLOutput::AudioCallback(Uint8* stream, int len) {
 		int bytes = len - filled;
 		memset(stream + filled, audio_spec.silence, bytes);
 
-		if(silence_len == 0)
+		if(silence_len == 0) {
 			fprintf(stderr, "SDLOutput: silence started...\n");
+			underruns++;
+		}
 		silence_len += bytes;
 	}
 }
 
 size_t SDLOutput::GetAudio(uint8_t *data, size_t len) {
-	std::lock_guard<std::mutex> lock(audio_buffer_mutex);
+	// (re)start prebuffering, if requested
+	size_t prebuffer_requests = audio_prebuffer_requests;
+	if(audio_prebuffer_requests_done != prebuffer_requests) {
+		audio_prebuffer_requests_done = prebuffer_requests;
+		audio_prebuffering = true;
+	}
+	if(audio_prebuffering) {
+		if(audio_buffer->Size() < audio_start_buffer_size) {
+			// output silence
+			memset(data, audio_spec.silence, len);
+			return len;
+		}
+		audio_prebuffering = false;
+		ResetPlayout();
+
+		audio_start_delay_ms = steady_clock_ms() - audio_start_time;
+		fprintf(stderr, "SDLOutput: audio started after %zu ms\n", audio_start_delay_ms.load());
+	}
 
-	if(audio_start_buffer_size && audio_buffer->Size() >= audio_start_buffer_size)
-		audio_start_buffer_size = 0;
+	UpdatePlayout();
 
-	// output silence, if needed
-	if(audio_volume == 0.0 || audio_mute || audio_start_buffer_size) {
-		if(audio_start_buffer_size == 0)
-			audio_buffer->Read(nullptr, len);
-		memset(data, audio_spec.silence, len);
-		return len;
-	}
+	// feed the resampler with the needed input
+	size_t frame_size = buffer_channels * sizeof(int16_t);
+	size_t output_frame_size = audio_spec.channels * sizeof(int16_t);
+	size_t output_frames = len / output_frame_size;
 
-	// output buffer, if full volume
-	if(audio_volume == 1.0)
-		return audio_buffer->Read(data, len);
+	const uint8_t *data_1;
+	const uint8_t *data_2;
+	size_t len_1;
+	size_t len_2;
+	size_t input_len = audio_buffer->Peek(audio_resampler.GetInputFramesNeeded(output_frames) * frame_size, data_1, len_1, data_2, len_2);
+	audio_resampler.PutInput((const int16_t*) data_1, len_1 / frame_size);
+	audio_resampler.PutInput((const int16_t*) data_2, len_2 / frame_size);
+	audio_buffer->Skip(input_len);
 
-	// output buffer after volume adjustment
-	audio_mix_buffer.resize(len);
-	size_t got_len = audio_buffer->Read(&audio_mix_buffer[0], len);
+	// output resampled buffer, applying volume (incl. mute)
+	size_t frames = audio_resampler.Process((int16_t*) data, output_frames);
+	audio_gain.Process((int16_t*) data, (const int16_t*) data, frames * audio_spec.channels);
 
-	memset(data, audio_spec.silence, got_len);
-	SDL_MixAudioFormat(data, &audio_mix_buffer[0], audio_spec.format, got_len, SDL_MIX_MAXVOLUME * audio_volume);
+	return frames * output_frame_size;
+}
+
+void SDLOutput::ResetPlayout() {
+	audio_resampler.Reset();
+	audio_resampler.SetRatio((double) samplerate / audio_spec.freq);
+	audio_fill_avg = audio_start_buffer_size / (buffer_channels * sizeof(int16_t));
+	audio_drift_integral = 0.0;
+	audio_drift_ppm = 0.0;
+}
 
-	return got_len;
+void SDLOutput::UpdatePlayout() {
+	/* The sound card clock usually differs slightly from the (DAB) source
+	 * clock, so the buffer fill level drifts away from the target latency.
+	 * Therefore the playout rate is adjusted (by resampling) according to
+	 * the smoothed fill level deviation.
+	 */
+	double target_frames = audio_start_buffer_size / (buffer_channels * sizeof(int16_t));
+	double fill_frames = audio_buffer->Size() / (buffer_channels * sizeof(int16_t)) + audio_resampler.GetBufferedFrames();
+	audio_fill_avg += (fill_frames - audio_fill_avg) * playout_fill_avg_alpha;
+
+	double error = (audio_fill_avg - target_frames) / samplerate;	// in seconds
+	audio_drift_integral = std::min(std::max(audio_drift_integral + error * playout_ki, -playout_max_deviation), playout_max_deviation);
+	double deviation = std::min(std::max(error * playout_kp + audio_drift_integral, -playout_max_deviation), playout_max_deviation);
+
+	audio_resampler.SetRatio((double) samplerate / audio_spec.freq * (1.0 + deviation));
+	audio_drift_ppm = deviation * 1000000;
 }
@@ -25,11 +25,13 @@
 #include <stdexcept>
 #include <stdint.h>
 #include <string>
-#include <mutex>
 #include <vector>
 #include <atomic>
+#include <chrono>
 
+#include "audio_gain.h"
 #include "audio_output.h"
+#include "resampler.h"
 #include "tools.h"
 
 
@@ -42,6 +44,18 @@ public:
 };
 
 
+// --- SDL_OUTPUT_STATS -----------------------------------------------------------------
+struct SDL_OUTPUT_STATS {
+	size_t underruns;		// callbacks that had to be (partly) filled with silence
+	size_t overruns;		// PutAudio calls that could not store all samples
+	size_t overrun_bytes;
+	double drift_ppm;		// current playout rate correction
+	size_t start_delay_ms;	// from the last (re)start request until audio output
+
+	SDL_OUTPUT_STATS() : underruns(0), overruns(0), overrun_bytes(0), drift_ppm(0.0), start_delay_ms(0) {}
+};
+
+
 // --- SDLOutput -----------------------------------------------------------------
 class SDLOutput : public AudioOutput, AudioSource {
 private:
@@ -49,20 +63,51 @@ private:
 	SDL_AudioSpec audio_spec;
 	int silence_len;
 
-	int samplerate;
-	int channels;
+	int samplerate;		// input
+	int channels;		// input
+	int buffer_channels;	// after channel mapping
+	bool fixed_output_format;
+	std::vector<int16_t> audio_upmix_buffer;
+
+	static const int fixed_samplerate;
+	static const int fixed_channels;
 
-	std::mutex audio_buffer_mutex;
-	CircularBuffer *audio_buffer;
+	SPSCRingBuffer *audio_buffer;
 	size_t audio_start_buffer_size;
-	std::vector<uint8_t> audio_mix_buffer;
+	std::atomic<size_t> audio_prebuffer_requests;	// producer only
+	size_t audio_prebuffer_requests_done;			// consumer only
+	bool audio_prebuffering;						// consumer only
+	AudioGain audio_gain;
+
+	// playout control (consumer only)
+	size_t audio_latency_ms;
+	Resampler audio_resampler;
+	double audio_fill_avg;
+	double audio_drift_integral;
+	std::atomic<double> audio_drift_ppm;
+
+	static const size_t default_audio_latency_ms;
+	static const double playout_fill_avg_alpha;
+	static const double playout_kp;
+	static const double playout_ki;
+	static const double playout_max_deviation;
+
+	std::atomic<int64_t> audio_start_time;	// of the last (re)start request, in ms
+	std::atomic<size_t> audio_start_delay_ms;
+
+	std::atomic<size_t> underruns;
+	std::atomic<size_t> overruns;
+	std::atomic<size_t> overrun_bytes;
 
 	std::atomic<bool> audio_mute;
 	std::atomic<double> audio_volume;
 
 	void AudioCallback(Uint8* stream, int len);
 	size_t GetAudio(uint8_t *data, size_t len);
-	void SetAudioStartBufferSize();
+	void SetInputFormat(int samplerate, int channels);
+	void ResetPlayout();
+	void UpdatePlayout();
+	void UpdateAudioGain() {audio_gain.SetGain(audio_mute ? 0.0 : audio_volume.load());}
 public:
 	SDLOutput();
 	~SDLOutput();
@@ -70,9 +115,13 @@ public:
 	void StartAudio(int samplerate, int channels);
 	void StopAudio();
 	void PutAudio(const uint8_t *data, size_t len);
-	void SetAudioMute(bool audio_mute) {this->audio_mute = audio_mute;}
-	void SetAudioVolume(double audio_volume) {this->audio_volume = audio_volume;}
+	void SetAudioMute(bool audio_mute) {this->audio_mute = audio_mute; UpdateAudioGain();}
+	void SetAudioVolume(double audio_volume) {this->audio_volume = audio_volume; UpdateAudioGain();}
 	bool HasAudioVolumeControl() {return true;}
+	void SetAudioLatency(size_t audio_latency_ms) {this->audio_latency_ms = audio_latency_ms;}
+	void SetFixedOutputFormat(bool fixed_output_format) {this->fixed_output_format = fixed_output_format;}
+
+	SDL_OUTPUT_STATS GetStats();
 };
 
 #endif /* SDL_OUTPUT_H_ */
@@ -23,6 +23,7 @@
 #include <mutex>
 #include <set>
 #include <string>
+#include <vector>
 
 #define FPAD_LEN 2
 
@@ -57,12 +58,37 @@ public:
 };
 
 
+// --- UNTOUCHED_STREAM_PART -----------------------------------------------------------------
+struct UNTOUCHED_STREAM_PART {
+	const uint8_t *data;
+	size_t len;
+};
+
+
 // --- UntouchedStreamConsumer -----------------------------------------------------------------
 class UntouchedStreamConsumer {
+private:
+	std::vector<uint8_t> joined_parts;
 public:
 	virtual ~UntouchedStreamConsumer() {}
 
 	virtual void ProcessUntouchedStream(const uint8_t* /*data*/, size_t /*len*/, size_t /*duration_ms*/) = 0;
+	virtual void UntouchedStreamChangeFormat(const std::string& /*file_extension*/) {}	// only for consumers kept across services; empty, if no service
+	virtual void UntouchedStreamAudioFormat(const AUDIO_SERVICE_FORMAT& /*format*/) {}	// the audio format of the following frames/AUs
+	virtual void UntouchedStreamGap(size_t /*duration_ms*/) {}	// frames/AUs dropped e.g. due to a CRC error
+
+	// scatter-gather variant (e.g. for writev); by default the parts are joined for the contiguous variant
+	virtual void ProcessUntouchedStreamParts(const UNTOUCHED_STREAM_PART* parts, size_t count, size_t duration_ms) {
+		if(count == 1) {
+			ProcessUntouchedStream(parts[0].data, parts[0].len, duration_ms);
+			return;
+		}
+
+		joined_parts.clear();
+		for(size_t i = 0; i < count; i++)
+			joined_parts.insert(joined_parts.end(), parts[i].data, parts[i].data + parts[i].len);
+		ProcessUntouchedStream(&joined_parts[0], joined_parts.size(), duration_ms);
+	}
 };
 
 
@@ -74,11 +100,23 @@ protected:
 
 	std::mutex uscs_mutex;
 	std::set<UntouchedStreamConsumer*> uscs;
+	AUDIO_SERVICE_FORMAT uscs_format;	// for consumers added later
 
-	void ForwardUntouchedStream(const uint8_t *data, size_t len, size_t duration_ms) {
+	void ForwardUntouchedStream(const UNTOUCHED_STREAM_PART* parts, size_t count, size_t duration_ms) {
 		// mutex must already be locked!
 		for(UntouchedStreamConsumer* usc : uscs)
-			usc->ProcessUntouchedStream(data, len, duration_ms);
+			usc->ProcessUntouchedStreamParts(parts, count, duration_ms);
+	}
+	void ForwardUntouchedStreamAudioFormat(const AUDIO_SERVICE_FORMAT& format) {
+		std::lock_guard<std::mutex> lock(uscs_mutex);
+		uscs_format = format;
+		for(UntouchedStreamConsumer* usc : uscs)
+			usc->UntouchedStreamAudioFormat(format);
+	}
+	void ForwardUntouchedStreamGap(size_t duration_ms) {
+		std::lock_guard<std::mutex> lock(uscs_mutex);
+		for(UntouchedStreamConsumer* usc : uscs)
+			usc->UntouchedStreamGap(duration_ms);
 	}
 public:
 	SubchannelSink(SubchannelSinkObserver* observer, std::string untouched_stream_file_extension) :
@@ -90,6 +128,8 @@ public:
 	void AddUntouchedStreamConsumer(UntouchedStreamConsumer* consumer) {
 		std::lock_guard<std::mutex> lock(uscs_mutex);
 		uscs.insert(consumer);
+		if(!uscs_format.codec.empty())
+			consumer->UntouchedStreamAudioFormat(uscs_format);
 	}
 	void RemoveUntouchedStreamConsumer(UntouchedStreamConsumer* consumer) {
 		std::lock_guard<std::mutex> lock(uscs_mutex);
@@ -0,0 +1,163 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "tee_output.h"
+
+
+// --- TeeOutputSink -----------------------------------------------------------------
+const size_t TeeOutputSink::max_audio_items = 84;	// about 2s of DAB+ audio
+
+TeeOutputSink::TeeOutputSink(AudioOutput *out) {
+	this->out = out;
+
+	queue_audio_items = 0;
+	do_exit = false;
+	overflow = false;
+	dropped_buffers = 0;
+
+	thread = std::thread(&TeeOutputSink::Worker, this);
+}
+
+TeeOutputSink::~TeeOutputSink() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		do_exit = true;
+	}
+	cond.notify_one();
+	thread.join();
+
+	if(dropped_buffers)
+		fprintf(stderr, "TeeOutputSink: %zu audio buffers dropped\n", dropped_buffers.load());
+
+	delete out;
+}
+
+void TeeOutputSink::Put(const TEE_OUTPUT_ITEM& item) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		// never stall the decoder due to a slow output; control items are always queued
+		if(item.type == TEE_OUTPUT_ITEM::Type::Audio) {
+			if(queue_audio_items == max_audio_items) {
+				if(!overflow) {
+					fprintf(stderr, "TeeOutputSink: queue overflow, dropping audio...\n");
+					overflow = true;
+				}
+				dropped_buffers++;
+				return;
+			}
+			if(queue_audio_items < max_audio_items / 2)
+				overflow = false;
+			queue_audio_items++;
+		}
+		queue.push_back(item);
+	}
+	cond.notify_one();
+}
+
+void TeeOutputSink::Worker() {
+	std::unique_lock<std::mutex> lock(mutex);
+	for(;;) {
+		// on exit, process the remaining items first
+		cond.wait(lock, [&]{return do_exit || !queue.empty();});
+		if(queue.empty())
+			break;
+
+		TEE_OUTPUT_ITEM item = queue.front();
+		queue.pop_front();
+		if(item.type == TEE_OUTPUT_ITEM::Type::Audio)
+			queue_audio_items--;
+
+		// process without lock
+		lock.unlock();
+		switch(item.type) {
+		case TEE_OUTPUT_ITEM::Type::Start:
+			out->StartAudio(item.samplerate, item.channels);
+			break;
+		case TEE_OUTPUT_ITEM::Type::Stop:
+			out->StopAudio();
+			break;
+		case TEE_OUTPUT_ITEM::Type::Audio:
+			out->PutAudio(&(*item.buffer)[0], item.buffer->size());
+			break;
+		}
+		lock.lock();
+	}
+}
+
+
+// --- TeeOutput -----------------------------------------------------------------
+TeeOutput::~TeeOutput() {
+	for(TeeOutputSink* sink : sinks)
+		delete sink;
+}
+
+void TeeOutput::AddOutput(AudioOutput *out) {
+	sinks.push_back(new TeeOutputSink(out));
+}
+
+void TeeOutput::Put(const TEE_OUTPUT_ITEM& item) {
+	for(TeeOutputSink* sink : sinks)
+		sink->Put(item);
+}
+
+void TeeOutput::StartAudio(int samplerate, int channels) {
+	TEE_OUTPUT_ITEM item = {TEE_OUTPUT_ITEM::Type::Start, samplerate, channels, nullptr};
+	Put(item);
+}
+
+void TeeOutput::StopAudio() {
+	TEE_OUTPUT_ITEM item = {TEE_OUTPUT_ITEM::Type::Stop, 0, 0, nullptr};
+	Put(item);
+}
+
+void TeeOutput::PutAudio(const uint8_t *data, size_t len) {
+	// copy once, then share among all sinks
+	TEE_OUTPUT_ITEM item = {TEE_OUTPUT_ITEM::Type::Audio, 0, 0, std::make_shared<const std::vector<uint8_t>>(data, data + len)};
+	Put(item);
+}
+
+// mute/volume only affect the main output, so that e.g. a recording is not muted
+void TeeOutput::SetAudioMute(bool audio_mute) {
+	if(!sinks.empty())
+		sinks[0]->GetOutput()->SetAudioMute(audio_mute);
+}
+
+void TeeOutput::SetAudioVolume(double audio_volume) {
+	if(!sinks.empty())
+		sinks[0]->GetOutput()->SetAudioVolume(audio_volume);
+}
+
+bool TeeOutput::HasAudioVolumeControl() {
+	return sinks.empty() ? false : sinks[0]->GetOutput()->HasAudioVolumeControl();
+}
+
+void TeeOutput::SetAudioLatency(size_t audio_latency_ms) {
+	for(TeeOutputSink* sink : sinks)
+		sink->GetOutput()->SetAudioLatency(audio_latency_ms);
+}
+
+void TeeOutput::SetFixedOutputFormat(bool fixed_output_format) {
+	for(TeeOutputSink* sink : sinks)
+		sink->GetOutput()->SetFixedOutputFormat(fixed_output_format);
+}
+
+void TeeOutput::SetBatchedWriter(BatchedWriter* writer) {
+	for(TeeOutputSink* sink : sinks)
+		sink->GetOutput()->SetBatchedWriter(writer);
+}
@@ -0,0 +1,102 @@
+/*
+    DABlin - capital DAB experience
+    Copyright (C) 2015-2024 Stefan Pöschel
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEE_OUTPUT_H_
+#define TEE_OUTPUT_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "audio_output.h"
+
+
+typedef std::shared_ptr<const std::vector<uint8_t>> tee_audio_buffer_t;
+
+
+// --- TEE_OUTPUT_ITEM -----------------------------------------------------------------
+struct TEE_OUTPUT_ITEM {
+	enum class Type {Start, Stop, Audio};
+
+	Type type;
+	int samplerate;
+	int channels;
+	tee_audio_buffer_t buffer;	// shared by all sinks
+};
+
+
+// --- TeeOutputSink -----------------------------------------------------------------
+// feeds an output from its own thread, decoupled by a bounded queue
+class TeeOutputSink {
+private:
+	AudioOutput *out;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::deque<TEE_OUTPUT_ITEM> queue;
+	size_t queue_audio_items;
+	bool do_exit;
+	bool overflow;
+
+	std::atomic<size_t> dropped_buffers;
+
+	void Worker();
+public:
+	TeeOutputSink(AudioOutput *out);
+	~TeeOutputSink();
+
+	void Put(const TEE_OUTPUT_ITEM& item);
+	AudioOutput* GetOutput() {return out;}
+
+	static const size_t max_audio_items;
+};
+
+
+// --- TeeOutput -----------------------------------------------------------------
+// distributes the audio to several outputs
+class TeeOutput : public AudioOutput {
+private:
+	std::vector<TeeOutputSink*> sinks;
+
+	void Put(const TEE_OUTPUT_ITEM& item);
+public:
+	TeeOutput() : AudioOutput() {}
+	~TeeOutput();
+
+	void AddOutput(AudioOutput *out);	// takes ownership; must be called before audio is started; the first one is the main output
+
+	void StartAudio(int samplerate, int channels);
+	void StopAudio();
+	void PutAudio(const uint8_t *data, size_t len);
+	void SetAudioMute(bool audio_mute);
+	void SetAudioVolume(double audio_volume);
+	bool HasAudioVolumeControl();
+
+	void SetAudioLatency(size_t audio_latency_ms);
+	void SetFixedOutputFormat(bool fixed_output_format);
+	void SetBatchedWriter(BatchedWriter* writer);
+};
+
+#endif /* TEE_OUTPUT_H_ */
@@ -133,23 +133,32 @@ std::string CharsetTools::ConvertCharEBUToUTF8(const uint8_t value) {
 	return std::string((char*) &value, 1);
 }
 
-std::string CharsetTools::ConvertStringIconvToUTF8(const std::vector<uint8_t>& cleaned_data, std::string* charset_name, const std::string& src_charset) {
+CharsetTools::EBU_UTF8_TABLE::EBU_UTF8_TABLE() {
+	for(int i = 0; i < 256; i++) {
+		std::string value = ConvertCharEBUToUTF8(i);
+		lens[i] = value.size();
+		memcpy(chars[i], value.data(), value.size());
+	}
+}
+
+const CharsetTools::EBU_UTF8_TABLE CharsetTools::ebu_utf8_table;
+thread_local IconvCache CharsetTools::iconv_cache;
+thread_local std::vector<uint8_t> CharsetTools::cleaned_data;
+
+std::string CharsetTools::ConvertStringIconvToUTF8(std::string* charset_name, const std::string& src_charset) {
 	// prepare
-	iconv_t conv = iconv_open("UTF-8", src_charset.c_str());
+	iconv_t conv = iconv_cache.Get(src_charset);
 	if(conv == (iconv_t) -1) {
 		perror("CharsetTools: error while iconv_open");
 		return "";
 	}
 
+	char* input = (char*) cleaned_data.data();	// not modified by iconv
 	size_t input_len = cleaned_data.size();
-	char input_bytes[input_len];
-	char* input = input_bytes;
-	memcpy(input_bytes, &cleaned_data[0], cleaned_data.size());
 
-	size_t output_len = input_len * 4; // theoretical worst case
-	size_t output_len_orig = output_len;
-	char output_bytes[output_len];
-	char* output = output_bytes;
+	std::string result(input_len * 4, '\0');	// theoretical worst case
+	char* output = &result[0];
+	size_t output_len = result.size();
 
 	// convert
 	size_t count = iconv(conv, &input, &input_len, &output, &output_len);
@@ -161,51 +170,64 @@ std::string CharsetTools::ConvertStringIconvToUTF8(const std::vector<uint8_t>& c
 		fprintf(stderr, "CharsetTools: Could not convert all chars to %s!\n", src_charset.c_str());
 		return "";
 	}
-
-	if(iconv_close(conv)) {
-		perror("CharsetTools: error while iconv_close");
-		return "";
-	}
+	result.resize(result.size() - output_len);
 
 	if(charset_name)
 		*charset_name = src_charset;
-	return std::string(output_bytes, output_len_orig - output_len);
+	return result;
 }
 
-std::string CharsetTools::ConvertTextToUTF8(const uint8_t *data, size_t len, int charset, bool mot, std::string* charset_name) {
-	// remove undesired chars
-	std::vector<uint8_t> cleaned_data;
-	for(size_t i = 0; i < len; i++) {
-		switch(data[i]) {
-		case 0x00:	// NULL
-		case 0x0A:	// PLB
-		case 0x0B:	// EoH
-		case 0x1F:	// PWB
-			continue;
-		default:
-			cleaned_data.push_back(data[i]);
-		}
+bool CharsetTools::IsUndesiredChar(const uint8_t value) {
+	switch(value) {
+	case 0x00:	// NULL
+	case 0x0A:	// PLB
+	case 0x0B:	// EoH
+	case 0x1F:	// PWB
+		return true;
+	default:
+		return false;
 	}
+}
 
-	// convert characters
+std::string CharsetTools::ConvertTextToUTF8(const uint8_t *data, size_t len, int charset, bool mot, std::string* charset_name) {
+	// convert characters (removing undesired chars)
 	if(charset == 0b0000) {			// EBU Latin based
 		if(charset_name)
 			*charset_name = "EBU Latin based";
 
-		std::string result;
-		for(const uint8_t& c : cleaned_data)
-			result += ConvertCharEBUToUTF8(c);
+		std::string result(len * sizeof(ebu_utf8_table.chars[0]), '\0');	// worst case
+		size_t result_len = 0;
+		for(size_t i = 0; i < len; i++) {
+			if(IsUndesiredChar(data[i]))
+				continue;
+			memcpy(&result[result_len], ebu_utf8_table.chars[data[i]], ebu_utf8_table.lens[data[i]]);
+			result_len += ebu_utf8_table.lens[data[i]];
+		}
+		result.resize(result_len);
 		return result;
 	}
-	if(charset == 0b0100 && mot)	// ISO/IEC-8859-1 (MOT only)
-		return ConvertStringIconvToUTF8(cleaned_data, charset_name, "ISO-8859-1");
-	if(charset == 0b0110 && !mot)	// UCS-2 BE (DAB only)
-		return ConvertStringIconvToUTF8(cleaned_data, charset_name, "UCS-2BE");
 	if(charset == 0b1111) {			// UTF-8
 		if(charset_name)
 			*charset_name = "UTF-8";
 
-		return std::string((char*) &cleaned_data[0], cleaned_data.size());
+		std::string result;
+		result.reserve(len);
+		for(size_t i = 0; i < len; i++)
+			if(!IsUndesiredChar(data[i]))
+				result.push_back(data[i]);
+		return result;
+	}
+
+	if((charset == 0b0100 && mot) || (charset == 0b0110 && !mot)) {
+		cleaned_data.clear();
+		for(size_t i = 0; i < len; i++)
+			if(!IsUndesiredChar(data[i]))
+				cleaned_data.push_back(data[i]);
+
+		if(charset == 0b0100)		// ISO/IEC-8859-1 (MOT only)
+			return ConvertStringIconvToUTF8(charset_name, "ISO-8859-1");
+		else						// UCS-2 BE (DAB only)
+			return ConvertStringIconvToUTF8(charset_name, "UCS-2BE");
 	}
 
 	// ignore unsupported charset
@@ -214,6 +236,28 @@ std::string CharsetTools::ConvertTextToUTF8(const uint8_t *data, size_t len, int
 }
 
 
+// --- IconvCache -----------------------------------------------------------------
+IconvCache::~IconvCache() {
+	for(auto& conv : convs)
+		if(iconv_close(conv.second))
+			perror("IconvCache: error while iconv_close");
+}
+
+iconv_t IconvCache::Get(const std::string& src_charset) {
+	auto it = convs.find(src_charset);
+	if(it == convs.end()) {
+		iconv_t conv = iconv_open("UTF-8", src_charset.c_str());
+		if(conv == (iconv_t) -1)
+			return conv;
+		it = convs.insert(std::make_pair(src_charset, conv)).first;
+	} else {
+		// reset conversion state
+		iconv(it->second, nullptr, nullptr, nullptr, nullptr);
+	}
+	return it->second;
+}
+
+
 // --- CalcCRC -----------------------------------------------------------------
 CalcCRC CalcCRC::CalcCRC_CRC16_CCITT(true, true, 0x1021);	// 0001 0000 0010 0001 (16, 12, 5, 0)
 CalcCRC CalcCRC::CalcCRC_CRC16_IBM(true, false, 0x8005);	// 1000 0000 0000 0101 (16, 15, 2, 0)
@@ -263,8 +307,13 @@ void CalcCRC::ProcessBits(uint16_t& crc, const uint8_t *data, size_t len) {
 
 	for(size_t offset = 0; offset < bytes; offset++)
 		ProcessByte(crc, data[offset]);
-	for(size_t bit = 0; bit < bits; bit++)
-		ProcessBit(crc, data[bytes] & (0x80 >> bit));
+
+	// remaining bits: merge all at once, then shift them out
+	if(bits) {
+		crc ^= (data[bytes] & (0xFF00 >> bits)) << 8;
+		for(size_t bit = 0; bit < bits; bit++)
+			crc = (crc & 0x8000) ? ((crc << 1) ^ gen_polynom) : (crc << 1);
+	}
 }
 
 
@@ -316,67 +365,155 @@ size_t CircularBuffer::Read(uint8_t *data, size_t bytes) {
 }
 
 
-// --- BitReader -----------------------------------------------------------------
-bool BitReader::GetBits(int& result, size_t count) {
-	int result_value = 0;
+// --- SPSCRingBuffer -----------------------------------------------------------------
+SPSCRingBuffer::SPSCRingBuffer(size_t capacity) : index_write(0), index_read(0), index_discard(0) {
+	buffer = new uint8_t[capacity];
+	this->capacity = capacity;
+}
+
+SPSCRingBuffer::~SPSCRingBuffer() {
+	delete[] buffer;
+}
 
-	while(count) {
-		if(data_bytes == 0)
-			return false;
+size_t SPSCRingBuffer::Write(const uint8_t *data, size_t bytes) {
+	size_t write = index_write.load(std::memory_order_relaxed);
+	// the space of discarded data is only reused after the consumer skipped it, as it may still read it
+	size_t real_bytes = std::min(bytes, capacity - (write - index_read.load(std::memory_order_acquire)));
 
-		size_t copy_bits = std::min(count, 8 - data_bits);
+	// split task on index rollover
+	size_t offset = write % capacity;
+	if(real_bytes <= capacity - offset) {
+		memcpy(buffer + offset, data, real_bytes);
+	} else {
+		size_t first_bytes = capacity - offset;
+		memcpy(buffer + offset, data, first_bytes);
+		memcpy(buffer, data + first_bytes, real_bytes - first_bytes);
+	}
 
-		result_value <<= copy_bits;
-		result_value |= (*data & (0xFF >> data_bits)) >> (8 - data_bits - copy_bits);
+	index_write.store(write + real_bytes, std::memory_order_release);
+	return real_bytes;
+}
 
-		data_bits += copy_bits;
-		count -= copy_bits;
+size_t SPSCRingBuffer::ApplyDiscard() {
+	size_t read = index_read.load(std::memory_order_relaxed);
+	size_t discard = index_discard.load(std::memory_order_acquire);
 
-		// switch to next byte
-		if(data_bits == 8) {
-			data++;
-			data_bytes--;
-			data_bits = 0;
-		}
+	// skip data that was written before the last clear
+	if((ptrdiff_t) (discard - read) > 0) {
+		read = discard;
+		index_read.store(read, std::memory_order_release);
+	}
+	return read;
+}
+
+size_t SPSCRingBuffer::Size() {
+	size_t read = ApplyDiscard();
+	return index_write.load(std::memory_order_acquire) - read;
+}
+
+size_t SPSCRingBuffer::Peek(size_t bytes, const uint8_t*& data_1, size_t& len_1, const uint8_t*& data_2, size_t& len_2) {
+	size_t read = ApplyDiscard();
+	size_t real_bytes = std::min(bytes, index_write.load(std::memory_order_acquire) - read);
+
+	// split task on index rollover
+	size_t offset = read % capacity;
+	data_1 = buffer + offset;
+	len_1 = std::min(real_bytes, capacity - offset);
+	data_2 = buffer;
+	len_2 = real_bytes - len_1;
+	return real_bytes;
+}
+
+size_t SPSCRingBuffer::Read(uint8_t *data, size_t bytes) {
+	const uint8_t *data_1;
+	const uint8_t *data_2;
+	size_t len_1;
+	size_t len_2;
+	size_t real_bytes = Peek(bytes, data_1, len_1, data_2, len_2);
+
+	if(data) {
+		memcpy(data, data_1, len_1);
+		memcpy(data + len_1, data_2, len_2);
 	}
 
-	result = result_value;
-	return true;
+	Skip(real_bytes);
+	return real_bytes;
+}
+
+
+// --- BitReader -----------------------------------------------------------------
+void BitReader::Refill() {
+	// top up the cache with whole bytes
+	while(cache_bits <= 56 && data_bytes) {
+		cache |= (uint64_t) *data << (56 - cache_bits);
+		cache_bits += 8;
+		data++;
+		data_bytes--;
+	}
 }
 
 
 // --- BitWriter -----------------------------------------------------------------
-void BitWriter::Reset() {
-	data.clear();
-	byte_bits = 0;
+void BitWriter::Rewind(size_t bits) {
+	// keep everything before the desired position (e.g. a header template)
+	buffer_len = bits / 8;
+	acc_bits = bits % 8;
+	EnsureCapacity(0);
+	acc = acc_bits ? (buffer[buffer_len] >> (8 - acc_bits)) : 0;
 }
 
 void BitWriter::AddBits(int data_new, size_t count) {
-	while(count) {
-		// add new byte, if needed
-		if(byte_bits == 0)
-			data.push_back(0x00);
-
-		size_t copy_bits = std::min(count, 8 - byte_bits);
-		uint8_t copy_data = (data_new >> (count - copy_bits)) & (0xFF >> (8 - copy_bits));
-		data.back() |= copy_data << (8 - byte_bits - copy_bits);
+	// up to 32 bits at once
+	if(count == 0)
+		return;
+	EnsureCapacity(4);
 
-//		fprintf(stderr, "data_new: 0x%04X, count: %zu / byte_bits: %zu, copy_bits: %zu, copy_data: 0x%02X\n", data_new, count, byte_bits, copy_bits, copy_data);
+	acc = (acc << count) | ((uint32_t) data_new & (0xFFFFFFFF >> (32 - count)));
+	acc_bits += count;
 
-		byte_bits = (byte_bits + copy_bits) % 8;
-		count -= copy_bits;
+	while(acc_bits >= 8) {
+		acc_bits -= 8;
+		buffer[buffer_len++] = acc >> acc_bits;
 	}
+	acc &= 0xFF >> (8 - acc_bits);
+
+	StorePartialByte();
 }
 
 void BitWriter::AddBytes(const uint8_t *data, size_t len) {
-	for(size_t i = 0; i < len; i++)
-		AddBits(data[i], 8);
+	EnsureCapacity(len);
+
+	// byte-aligned: bulk copy
+	if(acc_bits == 0) {
+		memcpy(&buffer[buffer_len], data, len);
+		buffer_len += len;
+		return;
+	}
+
+	// otherwise shift-merge four bytes at a time
+	size_t offset = 0;
+	for(; offset + 4 <= len; offset += 4) {
+		uint32_t word = (uint32_t) data[offset] << 24 | (uint32_t) data[offset + 1] << 16 | (uint32_t) data[offset + 2] << 8 | data[offset + 3];
+		acc = (acc << 32) | word;
+
+		uint32_t out = acc >> acc_bits;
+		buffer[buffer_len++] = out >> 24;
+		buffer[buffer_len++] = out >> 16;
+		buffer[buffer_len++] = out >> 8;
+		buffer[buffer_len++] = out;
+		acc &= 0xFF >> (8 - acc_bits);
+	}
+	for(; offset < len; offset++)
+		AddBits(data[offset], 8);
+
+	StorePartialByte();
 }
 
 void BitWriter::WriteAudioMuxLengthBytes() {
-	size_t len = data.size() - 3;
-	data[1] |= (len >> 8) & 0x1F;
-	data[2] = len & 0xFF;
+	// (re)patch the length; the header may be reused for several frames
+	size_t len = GetSize() - 3;
+	buffer[1] = (buffer[1] & 0xE0) | ((len >> 8) & 0x1F);
+	buffer[2] = len & 0xFF;
 }
 
 const dab_channels_t dab_channels {
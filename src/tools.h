@@ -20,12 +20,16 @@
 #define TOOLS_H_
 
 #include <algorithm>
+#include <atomic>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <string>
 #include <sstream>
 #include <map>
+#include <mutex>
+#include <functional>
+#include <utility>
 #include <vector>
 #include <iconv.h>
 
@@ -45,14 +49,38 @@ public:
 };
 
 
+// --- IconvCache -----------------------------------------------------------------
+// keeps opened iconv descriptors for reuse (not thread-safe; use one instance per thread)
+class IconvCache {
+private:
+	std::map<std::string,iconv_t> convs;
+public:
+	~IconvCache();
+
+	iconv_t Get(const std::string& src_charset);
+};
+
+
 // --- CharsetTools -----------------------------------------------------------------
 class CharsetTools {
 private:
+	struct EBU_UTF8_TABLE {
+		char chars[256][3];	// all chars are within the BMP
+		uint8_t lens[256];
+
+		EBU_UTF8_TABLE();
+	};
+
 	static const char* no_char;
 	static const char* ebu_values_0x00_to_0x1F[];
 	static const char* ebu_values_0x7B_to_0xFF[];
+	static const EBU_UTF8_TABLE ebu_utf8_table;
+	static thread_local IconvCache iconv_cache;
+	static thread_local std::vector<uint8_t> cleaned_data;
+
 	static std::string ConvertCharEBUToUTF8(const uint8_t value);
-	static std::string ConvertStringIconvToUTF8(const std::vector<uint8_t>& cleaned_data, std::string* charset_name, const std::string& src_charset);
+	static std::string ConvertStringIconvToUTF8(std::string* charset_name, const std::string& src_charset);
+	static bool IsUndesiredChar(const uint8_t value);
 public:
 	static std::string ConvertTextToUTF8(const uint8_t *data, size_t len, int charset, bool mot, std::string* charset_name);
 };
@@ -130,35 +158,195 @@ public:
 };
 
 
+// --- SPSCRingBuffer -----------------------------------------------------------------
+// wait-free ring buffer for exactly one producer and one consumer thread
+class SPSCRingBuffer {
+private:
+	static const size_t cache_line_size = 64;
+
+	uint8_t *buffer;
+	size_t capacity;
+
+	// the (ever increasing) indices are kept on separate cache lines
+	char padding_0[cache_line_size];
+	std::atomic<size_t> index_write;	// written by producer only
+	char padding_1[cache_line_size - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> index_read;		// written by consumer only
+	char padding_2[cache_line_size - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> index_discard;	// written by producer only
+	char padding_3[cache_line_size - sizeof(std::atomic<size_t>)];
+
+	size_t ApplyDiscard();
+public:
+	SPSCRingBuffer(size_t capacity);
+	~SPSCRingBuffer();
+
+	size_t Capacity() {return capacity;}
+
+	// producer side
+	size_t Write(const uint8_t *data, size_t bytes);
+	size_t Free() {return capacity - (index_write.load(std::memory_order_relaxed) - index_read.load(std::memory_order_acquire));}
+	void Clear() {index_discard.store(index_write.load(std::memory_order_relaxed), std::memory_order_release);}	// done by the consumer on next access; only then the space is free
+
+	// consumer side
+	size_t Read(uint8_t *data, size_t bytes);	// data may be nullptr to just discard
+	size_t Peek(size_t bytes, const uint8_t*& data_1, size_t& len_1, const uint8_t*& data_2, size_t& len_2);	// (the second part on index rollover)
+	void Skip(size_t bytes) {index_read.store(index_read.load(std::memory_order_relaxed) + bytes, std::memory_order_release);}	// only after Peek!
+	size_t Size();
+};
+
+
 // --- BitReader -----------------------------------------------------------------
 class BitReader {
 private:
 	const uint8_t *data;
 	size_t data_bytes;
-	size_t data_bits;
+	uint64_t cache;		// left-aligned
+	size_t cache_bits;
+
+	void Refill();
 public:
-	BitReader(const uint8_t *data, size_t data_bytes) : data(data), data_bytes(data_bytes), data_bits(0) {}
-	bool GetBits(int& result, size_t count);
+	BitReader(const uint8_t *data, size_t data_bytes) : data(data), data_bytes(data_bytes), cache(0), cache_bits(0) {}
+	bool GetBits(int& result, size_t count);	// up to 32 bits at once
 };
 
+inline bool BitReader::GetBits(int& result, size_t count) {
+	if(cache_bits < count) {
+		Refill();
+		if(cache_bits < count)
+			return false;
+	}
+
+	result = count ? cache >> (64 - count) : 0;
+	cache <<= count;
+	cache_bits -= count;
+	return true;
+}
+
 
 // --- BitWriter -----------------------------------------------------------------
 class BitWriter {
 private:
-	std::vector<uint8_t> data;
-	size_t byte_bits;
+	std::vector<uint8_t> buffer;	// size = capacity; incl. the pending partial byte
+	size_t buffer_len;				// complete bytes
+	uint64_t acc;					// pending bits (right-aligned)
+	size_t acc_bits;				// always < 8 between calls
+
+	void EnsureCapacity(size_t bytes) {
+		if(buffer.size() < buffer_len + bytes + 1)
+			buffer.resize(std::max(buffer.size() * 2, buffer_len + bytes + 1));
+	}
+	void StorePartialByte() {
+		if(acc_bits)
+			buffer[buffer_len] = acc << (8 - acc_bits);
+	}
 public:
 	BitWriter() {Reset();}
 
-	void Reset();
+	void Reset() {Rewind(0);}
+	void Rewind(size_t bits);
+	void Reserve(size_t bytes) {EnsureCapacity(bytes);}
 	void AddBits(int data_new, size_t count);
 	void AddBytes(const uint8_t *data, size_t len);
-	const std::vector<uint8_t> GetData() {return data;}
+	size_t GetBits() const {return buffer_len * 8 + acc_bits;}
+	const uint8_t* GetData() const {return &buffer[0];}
+	size_t GetSize() const {return buffer_len + (acc_bits ? 1 : 0);}
 
 	void WriteAudioMuxLengthBytes();	// needed for LATM
 };
 
 
+// --- HandlePool -----------------------------------------------------------------
+// keeps idle (already configured) decoder handles for reuse, grouped by config key
+template<typename T>
+class HandlePool {
+public:
+	typedef std::function<void(T)> deleter_t;
+private:
+	std::mutex mutex;
+	std::multimap<std::string,T> idle_handles;
+	size_t max_idle_handles;
+	deleter_t deleter;
+public:
+	HandlePool(size_t max_idle_handles, deleter_t deleter) : max_idle_handles(max_idle_handles), deleter(deleter) {}
+	virtual ~HandlePool() {Clear();}
+
+	bool Acquire(const std::string& key, T& handle);
+	void Release(const std::string& key, T handle);
+	void Clear();
+};
+
+template<typename T>
+bool HandlePool<T>::Acquire(const std::string& key, T& handle) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto it = idle_handles.find(key);
+	if(it == idle_handles.end())
+		return false;
+
+	handle = it->second;
+	idle_handles.erase(it);
+	return true;
+}
+
+template<typename T>
+void HandlePool<T>::Release(const std::string& key, T handle) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if(idle_handles.size() < max_idle_handles) {
+			idle_handles.insert(std::make_pair(key, handle));
+			return;
+		}
+	}
+
+	// pool full
+	deleter(handle);
+}
+
+template<typename T>
+void HandlePool<T>::Clear() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for(auto& idle_handle : idle_handles)
+		deleter(idle_handle.second);
+	idle_handles.clear();
+}
+
+
+// --- FixedVector -----------------------------------------------------------------
+// vector-like container with fixed capacity that never allocates
+template<typename T, size_t N>
+class FixedVector {
+private:
+	T items[N];
+	size_t count;
+public:
+	FixedVector() : count(0) {}
+
+	bool push_back(const T& item) {
+		if(count == N)
+			return false;
+		items[count++] = item;
+		return true;
+	}
+	template<typename... Args>
+	bool emplace_back(Args&&... args) {return push_back(T(std::forward<Args>(args)...));}
+	void clear() {count = 0;}
+
+	bool empty() const {return count == 0;}
+	size_t size() const {return count;}
+	static size_t capacity() {return N;}
+
+	T& operator[](size_t index) {return items[index];}
+	const T& operator[](size_t index) const {return items[index];}
+	T* begin() {return items;}
+	T* end() {return items + count;}
+	const T* begin() const {return items;}
+	const T* end() const {return items + count;}
+};
+
+
 typedef std::map<std::string,uint32_t> dab_channels_t;
 extern const dab_channels_t dab_channels;
 
@@ -21,15 +21,15 @@
 
 // --- WAVOutput -----------------------------------------------------------------
 void WAVOutput::WriteString(std::string value) {
-	fwrite(value.c_str(), value.length(), 1, stdout);
+	WriteOutput((const uint8_t*) value.c_str(), value.length());
 }
 
 void WAVOutput::WriteUInt16(uint16_t value) {
-	fwrite(&value, 2, 1, stdout);
+	WriteOutput((const uint8_t*) &value, 2);
 }
 
 void WAVOutput::WriteUInt32(uint32_t value) {
-	fwrite(&value, 4, 1, stdout);
+	WriteOutput((const uint8_t*) &value, 4);
 }
 
 void WAVOutput::ChangeFormat(int samplerate, int channels) {
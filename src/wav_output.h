@@ -33,7 +33,7 @@ private:
 protected:
 	virtual void ChangeFormat(int samplerate, int channels);
 public:
-	WAVOutput() : PCMOutput() {}
+	WAVOutput(const std::string& filename = "") : PCMOutput(filename) {}
 	~WAVOutput() {}
 };
 